@@ -0,0 +1,10 @@
+#ifndef CROSSOVER
+#define CROSSOVER
+
+extern bool mutate(Chromosome *chromosome, double mutation_probability,
+                   Rng *rng);
+extern Chromosome *crossover(Chromosome *parent1, Chromosome *parent2,
+                             double mutation_probability,
+                             ChromosomePool *pool, bool inherit, Rng *rng);
+
+#endif
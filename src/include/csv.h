@@ -0,0 +1,29 @@
+#ifndef CSV_H
+#define CSV_H
+
+#include <stddef.h>
+
+/*
+ * Columns loaded from a CSV file (or a dataset, see dataset.h). The values
+ * are held column-major: columns[j][i] is the value of the ith row in the
+ * jth loaded column. Loaded from a CSV, the columns are one contiguous
+ * block, columns[j + 1] == columns[j] + num_rows. Loaded from a dataset,
+ * they point into the mapping and values is NULL.
+ */
+typedef struct csv_table {
+    int num_rows;
+    int num_columns;
+    double *values;
+    void *mapping;
+    size_t mapping_size;
+    double *columns[];
+} CsvTable;
+
+extern CsvTable *load_csv(const char *filename, const char **columns,
+                          int no_of_columns, int workers);
+
+extern void free_csv(CsvTable *table);
+
+extern double parse_csv_number(const char *begin, const char *end);
+
+#endif
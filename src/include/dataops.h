@@ -0,0 +1,70 @@
+#ifndef DATA_OPS_H
+#define DATA_OPS_H
+
+#include <stdbool.h>
+
+// the window of the first versions, 5 days of open, high, low and close
+#define DEFAULT_WINDOW_DAYS 5
+#define DEFAULT_WINDOW_COLUMNS "Open,High,Low,Close"
+#define WINDOW_TARGET "Close"
+#define WINDOW_MAX_COLUMNS 8
+#define WINDOW_COLUMN_NAME_SIZE 32
+
+/*
+ * The inputs of a network: days consecutive rows of the named columns of a
+ * CSV, interleaved day by day, so that the network takes days * num_columns
+ * features. The target is the WINDOW_TARGET column of the row after the
+ * window, at index target among the columns.
+ */
+typedef struct window {
+    int days;
+    int num_columns;
+    int target;
+    char columns[WINDOW_MAX_COLUMNS][WINDOW_COLUMN_NAME_SIZE];
+} Window;
+
+/*
+ * Samples laid over a row-major block of values without copying them:
+ * sample i starts at base + i * stride, its values following contiguously.
+ * Samples overlap when stride is smaller than their length.
+ */
+typedef struct sample_view {
+    double *base;
+    int stride;
+    int num_samples;
+} SampleView;
+
+extern bool parse_window(Window *window, int days, const char *columns);
+
+extern bool window_for_inputs(Window *window, int num_inputs);
+
+extern int window_features(const Window *window);
+
+extern void window_column_names(const Window *window, const char **names);
+
+extern double get_min(double **matrix, double length, int index);
+
+extern double get_max(double **matrix, double length, int index);
+
+extern double **normalise(double **matrix, int rows, int columns);
+
+extern void rescale(double **matrix, double min, double max, int rows,
+                    int index);
+
+extern double *interleave_columns(double *const *columns, int no_of_rows,
+                                  int no_of_cols);
+
+extern void normalise_interleaved(double *rows, int no_of_rows,
+                                  int no_of_cols, double *min, double *max);
+
+extern int count_windows(int no_of_rows, int days, int step);
+
+extern SampleView window_view(double *rows, int no_of_rows, int no_of_cols,
+                              int days, int step);
+
+extern SampleView target_view(double *rows, int no_of_rows, int no_of_cols,
+                              int index, int days, int step);
+
+extern double **view_rows(SampleView view);
+
+#endif
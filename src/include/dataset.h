@@ -0,0 +1,17 @@
+#ifndef DATASET_H
+#define DATASET_H
+
+#include <stdbool.h>
+
+extern bool convert_csv(const char *csv_filename, const char *filename,
+                        const char **columns, int no_of_columns, int workers);
+
+extern bool is_dataset_file(const char *filename);
+
+extern CsvTable *map_dataset(const char *filename, const char **columns,
+                             int no_of_columns);
+
+extern CsvTable *load_dataset(const char *filename, const char **columns,
+                              int no_of_columns, int workers);
+
+#endif
@@ -0,0 +1,10 @@
+#ifndef FITNESS_CACHE
+#define FITNESS_CACHE
+
+extern FitnessCache *create_fitness_cache(double learning_rate_quantum,
+                                          int capacity);
+extern void fitness_cache_restore(FitnessCache *cache, Generation *generation);
+extern void fitness_cache_store(FitnessCache *cache, Generation *generation);
+extern void free_fitness_cache(FitnessCache *cache);
+
+#endif
@@ -0,0 +1,15 @@
+#ifndef MANAGE_NN_H
+#define MANAGE_NN_H
+
+#include <stdio.h>
+
+extern MLP *load_net(const char *filename, double *min, double *max);
+
+extern MLP *read_net(FILE *file, double *min, double *max);
+
+extern void save_nn(Chromosome *c, char name[], double **targets,
+                    int no_targets);
+
+extern void write_nn(FILE *nn, const Chromosome *c, double min, double max);
+
+#endif
@@ -0,0 +1,68 @@
+#ifndef MIGRATION_H
+#define MIGRATION_H
+
+#include <stdbool.h>
+#include <sys/types.h>
+
+/*
+ * typedef enum: migration_topology
+ * --------------------------------
+ * Which islands the fittest individuals of an island migrate to
+ * TOPOLOGY_RING - island i sends to island i + 1, the last one to island 0
+ * TOPOLOGY_FULL - every island sends to every other island
+ */
+typedef enum migration_topology {
+    TOPOLOGY_RING,
+    TOPOLOGY_FULL
+} MigrationTopology;
+
+/*
+ * typedef struct: island
+ * ----------------------
+ * One of the processes of an island model run, each evolving its own
+ * population
+ * id - the number of the island, 0 being the original process
+ * num_islands - the number of islands in the run
+ * topology - which islands migrants are sent to
+ * interval - the number of generations between two migrations
+ * migrants - the number of individuals sent to each neighbour per migration
+ * peers - a UNIX socket to every island this one exchanges migrants with,
+ *         indexed by island, -1 for islands it is not linked to
+ * results - island 0: a socket to every other island, over which their
+ *           fittest individuals are sent at the end. Other islands: only
+ *           their own socket to island 0 is used, at index 0
+ * children - island 0 only, the process ids of the other islands
+ */
+typedef struct island {
+    int id;
+    int num_islands;
+    MigrationTopology topology;
+    int interval;
+    int migrants;
+    int *peers;
+    int *results;
+    pid_t *children;
+} Island;
+
+extern bool parse_topology(const char *name, MigrationTopology *topology);
+
+extern Island *create_islands(int num_islands, MigrationTopology topology,
+                              int interval, int migrants);
+
+extern char *serialise_chromosomes(Chromosome **chromosomes, int count,
+                                   size_t *len);
+
+extern int deserialise_chromosomes(char *message, size_t len,
+                                   Chromosome **chromosomes);
+
+extern bool migration_due(const Island *island, int generation_number);
+
+extern void migrate(Island *island, GeneticState *state, double **targets,
+                    double **inputs, int no_inputs);
+
+extern void gather_fittest(Island *island, GeneticState *state,
+                           double **targets, double **inputs, int no_inputs);
+
+extern void free_island(Island *island);
+
+#endif
@@ -0,0 +1,21 @@
+#ifndef MODEL_H
+#define MODEL_H
+
+#include <stdio.h>
+#include <stdbool.h>
+
+extern void save_model(Chromosome *c, char name[], double **targets,
+                       int no_targets, const Window *window);
+
+extern void write_model(FILE *file, const MLP *mlp, double min, double max,
+                        const Window *window);
+
+extern bool is_model_file(const char *filename);
+
+extern MLP *map_model(const char *filename, double *min, double *max,
+                      Window *window);
+
+extern MLP *load_model(const char *filename, double *min, double *max,
+                       Window *window);
+
+#endif
@@ -0,0 +1,18 @@
+#ifndef SELECTION_H
+#define SELECTION_H
+
+extern double calculate_fitness(MLP *mlp, double **targets, double **inputs,
+                                int no_inputs);
+
+extern void evaluate_population(GeneticState *state, Chromosome **population,
+                                int size, double **targets, double **inputs,
+                                int no_inputs);
+
+extern void rank_population(Chromosome **population, int size);
+
+extern void calculate_fittest(GeneticState *state, double **targets,
+                              double **inputs, int no_inputs);
+
+extern Chromosome **get_parents(GeneticState *state, int number_of_pairs);
+
+#endif
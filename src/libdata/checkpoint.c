@@ -0,0 +1,248 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <assert.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+#include "structures.h"
+#include "createstructures.h"
+#include "checkpoint.h"
+
+#define CHECKPOINT_MAGIC "GSCK"
+#define CHECKPOINT_VERSION 3
+
+/*
+ * The checkpoint is a native endian binary file:
+ * 1. the magic "GSCK", the format version and sizeof(mlp_real)
+ * 2. the 4 words of state of the random number generator, the generation
+ *    number, the mutation probability, the population size and whether
+ *    there is a fittest individual
+ * 3. every chromosome of the current generation, then the fittest
+ *    individual: its fitness, learning rate, hidden layers, nodes per layer
+ *    and inherited flag, then the biases and weights of every layer of its
+ *    network
+ */
+
+static void write_value(FILE *file, const void *value, size_t size) {
+    if (fwrite(value, size, 1, file) != 1) {
+        perror("Could not write the checkpoint");
+        exit(EXIT_FAILURE);
+    }
+}
+
+static void read_value(FILE *file, void *value, size_t size) {
+    if (fread(value, size, 1, file) != 1) {
+        fprintf(stderr, "The checkpoint is truncated\n");
+        exit(EXIT_FAILURE);
+    }
+}
+
+static void write_chromosome(FILE *file, const Chromosome *chromosome) {
+    const uint8_t inherited = chromosome->inherited;
+    write_value(file, &chromosome->fitness, sizeof(double));
+    write_value(file, &chromosome->learning_rate, sizeof(double));
+    write_value(file, &chromosome->hidden_layers, sizeof(int));
+    write_value(file, &chromosome->nodes_per_layer, sizeof(int));
+    write_value(file, &inherited, sizeof(inherited));
+
+    for (Layer *l = chromosome->mlp->input_layer->next_layer; l;
+         l = l->next_layer) {
+        write_value(file, l->biases, l->num_outputs * sizeof(mlp_real));
+        write_value(file, l->weights,
+                    (size_t)l->num_inputs * l->num_outputs * sizeof(mlp_real));
+    }
+}
+
+static Chromosome *read_chromosome(FILE *file, int num_features) {
+    Chromosome *chromosome = create_chromosome();
+    uint8_t inherited;
+    read_value(file, &chromosome->fitness, sizeof(double));
+    read_value(file, &chromosome->learning_rate, sizeof(double));
+    read_value(file, &chromosome->hidden_layers, sizeof(int));
+    read_value(file, &chromosome->nodes_per_layer, sizeof(int));
+    read_value(file, &inherited, sizeof(inherited));
+    chromosome->inherited = inherited;
+
+    const int hidden_layers = chromosome->hidden_layers;
+    if (hidden_layers < HIDDEN_LAYERS_LOWER ||
+        hidden_layers > HIDDEN_LAYERS_UPPER ||
+        chromosome->nodes_per_layer < NODES_PER_LAYER_LOWER ||
+        chromosome->nodes_per_layer > NODES_PER_LAYER_UPPER) {
+        fprintf(stderr, "The checkpoint holds an invalid chromosome\n");
+        exit(EXIT_FAILURE);
+    }
+    int nodes[HIDDEN_LAYERS_UPPER + 2];
+    nodes[0] = num_features;
+    for (int j = 1; j <= hidden_layers; ++j) {
+        nodes[j] = chromosome->nodes_per_layer;
+    }
+    nodes[hidden_layers + 1] = NO_OUTPUTS;
+    chromosome->mlp = mlp_create(nodes, hidden_layers + 2);
+
+    for (Layer *l = chromosome->mlp->input_layer->next_layer; l;
+         l = l->next_layer) {
+        read_value(file, l->biases, l->num_outputs * sizeof(mlp_real));
+        read_value(file, l->weights,
+                   (size_t)l->num_inputs * l->num_outputs * sizeof(mlp_real));
+    }
+    return chromosome;
+}
+
+/*
+ * Function: save_checkpoint
+ * -------------------------
+ * Writes the whole state of the genetic algorithm to filename: the
+ * generation number, the mutation probability, the state of the random
+ * number generator, the number of inputs of the networks, every chromosome of the current generation with its
+ * network and the fittest individual. The file
+ * is first written under a temporary name and then renamed, so filename
+ * always holds a complete checkpoint.
+ *
+ * state: the state to save, between two generations
+ * filename: where the checkpoint goes
+ */
+void save_checkpoint(const GeneticState *state, const char *filename) {
+    assert(state && state->current_generation && filename);
+    const Generation *generation = state->current_generation;
+
+    char temporary[strlen(filename) + 5];
+    sprintf(temporary, "%s.tmp", filename);
+    FILE *file = fopen(temporary, "wb");
+    if (!file) {
+        perror("Could not create the checkpoint");
+        exit(EXIT_FAILURE);
+    }
+
+    const uint32_t version = CHECKPOINT_VERSION;
+    const uint32_t real_size = sizeof(mlp_real);
+    const uint8_t has_fittest = state->fittest_individual != NULL;
+    write_value(file, CHECKPOINT_MAGIC, 4);
+    write_value(file, &version, sizeof(version));
+    write_value(file, &real_size, sizeof(real_size));
+    write_value(file, state->rng.state, sizeof(state->rng.state));
+    write_value(file, &state->generation_number, sizeof(int));
+    write_value(file, &state->mutation_probability, sizeof(double));
+    write_value(file, &generation->population_size, sizeof(int));
+    write_value(file, &state->num_features, sizeof(int));
+    write_value(file, &has_fittest, sizeof(has_fittest));
+
+    for (int i = 0; i < generation->population_size; ++i) {
+        write_chromosome(file, generation->population[i]);
+    }
+    if (has_fittest) {
+        write_chromosome(file, state->fittest_individual);
+    }
+
+    if (fflush(file) || fsync(fileno(file)) || fclose(file)) {
+        perror("Could not write the checkpoint");
+        exit(EXIT_FAILURE);
+    }
+    if (rename(temporary, filename)) {
+        perror("Could not replace the checkpoint");
+        exit(EXIT_FAILURE);
+    }
+}
+
+/*
+ * Function: save_checkpoint_background
+ * ------------------------------------
+ * Same as save_checkpoint, but the checkpoint is written by a child
+ * process working on a copy-on-write snapshot of the state, so the caller
+ * can carry on with the next generation straight away. Returns the process
+ * id of the writer, to be passed to wait_checkpoint.
+ */
+pid_t save_checkpoint_background(const GeneticState *state,
+                                 const char *filename) {
+    fflush(stdout);
+    fflush(stderr);
+    const pid_t writer = fork();
+    if (writer < 0) {
+        perror("Could not start the checkpoint writer");
+        exit(EXIT_FAILURE);
+    }
+    if (writer == 0) {
+        save_checkpoint(state, filename);
+        _exit(EXIT_SUCCESS);
+    }
+    return writer;
+}
+
+/*
+ * Function: wait_checkpoint
+ * -------------------------
+ * Waits for a checkpoint started by save_checkpoint_background to be
+ * written. Does nothing if writer is 0.
+ */
+void wait_checkpoint(pid_t writer) {
+    if (writer > 0) {
+        int status;
+        if (waitpid(writer, &status, 0) < 0 || !WIFEXITED(status) ||
+            WEXITSTATUS(status) != 0) {
+            fprintf(stderr, "Writing the checkpoint failed\n");
+        }
+    }
+}
+
+/*
+ * Function: load_checkpoint
+ * -------------------------
+ * Returns a heap-allocated genetic state read back from a checkpoint
+ * written by save_checkpoint, random number generator included, so that the
+ * run carries on as it would have. The fitness function, number of workers and everything else not in the
+ * checkpoint are left for the caller to set.
+ */
+GeneticState *load_checkpoint(const char *filename) {
+    assert(filename);
+    FILE *file = fopen(filename, "rb");
+    if (!file) {
+        perror("Could not open the checkpoint");
+        exit(EXIT_FAILURE);
+    }
+
+    char magic[4];
+    uint32_t version, real_size;
+    uint8_t has_fittest;
+    read_value(file, magic, 4);
+    read_value(file, &version, sizeof(version));
+    read_value(file, &real_size, sizeof(real_size));
+    if (memcmp(magic, CHECKPOINT_MAGIC, 4) || version != CHECKPOINT_VERSION ||
+        real_size != sizeof(mlp_real)) {
+        fprintf(stderr, "%s is not a checkpoint of this build\n", filename);
+        exit(EXIT_FAILURE);
+    }
+
+    GeneticState *state = create_genetic_state();
+    read_value(file, state->rng.state, sizeof(state->rng.state));
+    Generation *generation = create_generation();
+    state->current_generation = generation;
+    read_value(file, &state->generation_number, sizeof(int));
+    read_value(file, &state->mutation_probability, sizeof(double));
+    read_value(file, &generation->population_size, sizeof(int));
+    read_value(file, &state->num_features, sizeof(int));
+    read_value(file, &has_fittest, sizeof(has_fittest));
+    if (generation->population_size <= 0) {
+        fprintf(stderr, "The checkpoint holds an empty population\n");
+        exit(EXIT_FAILURE);
+    }
+    if (state->num_features <= 0) {
+        fprintf(stderr, "The checkpoint holds networks without inputs\n");
+        exit(EXIT_FAILURE);
+    }
+
+    generation->population =
+        malloc(generation->population_size * sizeof(Chromosome *));
+    assert(generation->population);
+    for (int i = 0; i < generation->population_size; ++i) {
+        generation->population[i] =
+            read_chromosome(file, state->num_features);
+    }
+    if (has_fittest) {
+        state->fittest_individual =
+            read_chromosome(file, state->num_features);
+    }
+
+    fclose(file);
+    return state;
+}
@@ -0,0 +1,15 @@
+#ifndef CHECKPOINT_H
+#define CHECKPOINT_H
+
+#include <sys/types.h>
+
+extern void save_checkpoint(const GeneticState *state, const char *filename);
+
+extern pid_t save_checkpoint_background(const GeneticState *state,
+                                        const char *filename);
+
+extern void wait_checkpoint(pid_t writer);
+
+extern GeneticState *load_checkpoint(const char *filename);
+
+#endif
@@ -1,90 +1,444 @@
 #include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <limits.h>
 #include <assert.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
-#include "files.h"
+#include "parallel.h"
+#include "csv.h"
+
+// numbers with more significant digits than this are handed to strtod
+#define FAST_MAX_DIGITS 19
+// the largest mantissa a double holds exactly
+#define FAST_MAX_MANTISSA (1ULL << 53)
+// the largest power of ten a double holds exactly
+#define FAST_MAX_EXPONENT 22
+// fields shorter than this are copied on the stack for strtod
+#define NUMBER_BUFFER 64
+// files smaller than this are parsed on the calling thread alone
+#define PARALLEL_MIN_SIZE (1 << 20)
+// the smallest chunk a file is split into for parsing on several threads
+#define PARALLEL_MIN_CHUNK (1 << 18)
+// the number of chunks per worker, so that fast workers take on more
+#define CHUNKS_PER_WORKER 4
+
+/*
+ * typedef struct: csv_chunk
+ * -------------------------
+ * A run of whole lines [begin, end) of a CSV file, parsed by one task.
+ *
+ * first_row - index of the first row of the chunk in the unpacked columns
+ * num_rows - the number of lines of the chunk, then the number of rows
+ *            actually parsed (blank lines are skipped)
+ */
+typedef struct csv_chunk {
+    const char *begin;
+    const char *end;
+    int first_row;
+    int num_rows;
+} CsvChunk;
+
+typedef struct csv_parse {
+    CsvChunk *chunks;
+    const int *slot_of;
+    int num_fields;
+    double *const *columns;
+} CsvParse;
+
+static const double powers_of_ten[FAST_MAX_EXPONENT + 1] = {
+    1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
+
+static bool is_digit(char c) { return c >= '0' && c <= '9'; }
+
+/*
+ * Function: parse_fast
+ * --------------------
+ * Parses a decimal number (e.g. -12.5, 3e-4) spanning exactly [p, end)
+ * with Clinger's fast path: when the digits fit in the 53 bits of a double
+ * and the power of ten is exact, a single multiplication or division gives
+ * the correctly rounded result, the same as strtod. Returns false for
+ * anything else, leaving the number to strtod.
+ */
+static bool parse_fast(const char *p, const char *end, double *value) {
+    bool negative = false;
+    if (p < end && (*p == '-' || *p == '+')) {
+        negative = *p == '-';
+        p++;
+    }
+
+    uint64_t mantissa = 0;
+    int digits = 0;
+    int exponent = 0;
+    bool any_digit = false;
+    for (; p < end && is_digit(*p); p++) {
+        any_digit = true;
+        if (mantissa || *p != '0') {
+            if (++digits > FAST_MAX_DIGITS) {
+                return false;
+            }
+            mantissa = mantissa * 10 + (*p - '0');
+        }
+    }
+    if (p < end && *p == '.') {
+        for (p++; p < end && is_digit(*p); p++) {
+            any_digit = true;
+            if (mantissa || *p != '0') {
+                if (++digits > FAST_MAX_DIGITS) {
+                    return false;
+                }
+                mantissa = mantissa * 10 + (*p - '0');
+            }
+            exponent--;
+        }
+    }
+    if (!any_digit) {
+        return false;
+    }
+    if (p < end && (*p == 'e' || *p == 'E')) {
+        p++;
+        bool negative_exponent = false;
+        if (p < end && (*p == '-' || *p == '+')) {
+            negative_exponent = *p == '-';
+            p++;
+        }
+        if (p == end) {
+            return false;
+        }
+        int written = 0;
+        for (; p < end && is_digit(*p); p++) {
+            if (written > 2 * FAST_MAX_EXPONENT) {
+                return false;
+            }
+            written = written * 10 + (*p - '0');
+        }
+        exponent += negative_exponent ? -written : written;
+    }
+    if (p != end || mantissa > FAST_MAX_MANTISSA ||
+        exponent < -FAST_MAX_EXPONENT || exponent > FAST_MAX_EXPONENT) {
+        return false;
+    }
+
+    double result = (double)mantissa;
+    if (exponent < 0) {
+        result /= powers_of_ten[-exponent];
+    } else {
+        result *= powers_of_ten[exponent];
+    }
+    *value = negative ? -result : result;
+    return true;
+}
+
+/*
+ * Function: parse_csv_number
+ * --------------------------
+ * Converts the field [begin, end) (which does not need to be NUL terminated)
+ * to a double. Plain decimals take the fast path above, anything else
+ * (more than 19 digits, huge exponents, "nan", "null", ...) is converted by
+ * strtod, so the result is always exactly what strtod would give.
+ */
+double parse_csv_number(const char *begin, const char *end) {
+    assert(begin && end && begin <= end);
+    double value;
+    if (parse_fast(begin, end, &value)) {
+        return value;
+    }
+
+    const size_t length = end - begin;
+    char buffer[NUMBER_BUFFER];
+    char *copy = length < NUMBER_BUFFER ? buffer : malloc(length + 1);
+    assert(copy);
+    memcpy(copy, begin, length);
+    copy[length] = '\0';
+    value = strtod(copy, NULL);
+    if (copy != buffer) {
+        free(copy);
+    }
+    return value;
+}
+
+// returns the end of the field starting at p: the next ',', '\n' or end
+static const char *field_end(const char *p, const char *end) {
+    while (p < end && *p != ',' && *p != '\n') {
+        p++;
+    }
+    return p;
+}
+
+static void bad_csv(const char *filename, const char *reason) {
+    fprintf(stderr, "Could not load %s: %s\n", filename, reason);
+    exit(EXIT_FAILURE);
+}
+
+/*
+ * Function: parse_rows
+ * --------------------
+ * Parses the rows in [p, end) in a single pass, writing the field number f
+ * of the ith row to columns[slot_of[f]][first_row + i] (fields with a
+ * negative slot, or past num_fields, are skipped). Blank lines are skipped
+ * and missing fields are left as they are. Returns the number of rows parsed.
+ */
+static int parse_rows(const char *p, const char *end, const int *slot_of,
+                      int num_fields, double *const *columns, int first_row) {
+    int row = first_row;
+    while (p < end) {
+        if (*p == '\n' || (*p == '\r' && p + 1 < end && p[1] == '\n')) {
+            p += *p == '\n' ? 1 : 2;
+            continue;
+        }
+
+        for (int field = 0;; field++) {
+            const char *cell_end = field_end(p, end);
+            if (field < num_fields && slot_of[field] >= 0) {
+                const char *number_end = cell_end;
+                if (number_end > p && number_end[-1] == '\r') {
+                    number_end--;
+                }
+                columns[slot_of[field]][row] = parse_csv_number(p, number_end);
+            }
+            p = cell_end;
+            if (p == end || *p++ == '\n') {
+                break;
+            }
+        }
+        row++;
+    }
+    return row - first_row;
+}
+
+// returns the number of lines in [begin, end), the last one possibly
+// missing its newline
+static int count_lines(const char *begin, const char *end) {
+    int lines = begin < end && end[-1] != '\n';
+    for (const char *p = begin; (p = memchr(p, '\n', end - p)); p++) {
+        lines++;
+    }
+    return lines;
+}
+
+static void count_chunk(int index, void *arg) {
+    CsvChunk *chunk = ((CsvParse *)arg)->chunks + index;
+    chunk->num_rows = count_lines(chunk->begin, chunk->end);
+}
+
+static void parse_chunk(int index, void *arg) {
+    const CsvParse *parse = arg;
+    CsvChunk *chunk = parse->chunks + index;
+    chunk->num_rows = parse_rows(chunk->begin, chunk->end, parse->slot_of,
+                                 parse->num_fields, parse->columns,
+                                 chunk->first_row);
+}
+
+/*
+ * Function: split_chunks
+ * ----------------------
+ * Splits [begin, end) into up to num_chunks chunks of about the same size,
+ * every chunk but the last ending just after a newline so that no line is
+ * cut in two. Returns the number of chunks.
+ */
+static int split_chunks(const char *begin, const char *end, int num_chunks,
+                        CsvChunk *chunks) {
+    const size_t size = end - begin;
+    int count = 0;
+    const char *start = begin;
+    for (int k = 1; k <= num_chunks && start < end; k++) {
+        const char *stop =
+            k == num_chunks ? end : begin + size / num_chunks * k;
+        if (stop < start) {
+            stop = start;
+        }
+        if (stop < end) {
+            const char *newline = memchr(stop, '\n', end - stop);
+            stop = newline ? newline + 1 : end;
+        }
+        chunks[count++] = (CsvChunk){.begin = start, .end = stop};
+        start = stop;
+    }
+    return count;
+}
 
 /*
  * Function: load_csv
  * ------------------
  * Loads a CSV file with column names on the first row. Assumes that
- * all the given columns can be converted to doubles(!!)
+ * all the given columns can be converted to doubles(!!) and that no field
+ * is quoted.
+ *
+ * The file is mapped into memory and parsed in a single pass, every
+ * requested column at once, with no limit on the length of a line. Big
+ * files are split on line boundaries into chunks parsed by several
+ * threads; the result does not depend on the number of workers.
  *
  * filename: path to the csv file
  * columns: array of strings with the names of the columns that are to be
- * 		    loaded (they have to be in the order in which they appear in
- * the CSV file!) no_of_columns: no of columns to be loaded no_of_rows: the
- * function will set the value at this pointer to the number of rows read from
- * the file result: a matrix of doubles where result[i][j] means the value from
- * 		   the ith row and the jth column(as passed in the columns
- * array). It has to be FREED! Both the matrix itself and the rows.
+ * 		    loaded, in any order (a column may be asked for more than once)
+ * no_of_columns: no of columns to be loaded
+ * workers: maximum number of threads parsing the file
+ *
+ * result: a table where result->columns[j][i] is the value from the ith row
+ *         and the jth column (as passed in the columns array). It has to be
+ *         FREED with free_csv.
  */
-double **load_csv(const char *filename, const char **columns, int no_of_columns,
-                  int *no_of_rows) {
+CsvTable *load_csv(const char *filename, const char **columns,
+                   int no_of_columns, int workers) {
     assert(filename);
     assert(columns);
-    assert(no_of_rows);
+    assert(no_of_columns > 0);
+    assert(workers > 0);
 
-    FILE *file;
-    if (!(file = fopen(filename, "r"))) {
+    const int fd = open(filename, O_RDONLY);
+    if (fd < 0) {
         perror("Could not open the given CSV file");
         exit(EXIT_FAILURE);
     }
+    struct stat info;
+    if (fstat(fd, &info)) {
+        perror("Could not open the given CSV file");
+        exit(EXIT_FAILURE);
+    }
+    const size_t size = info.st_size;
+    if (size == 0) {
+        bad_csv(filename, "there is no column row");
+    }
+    const char *mapping = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (mapping == MAP_FAILED) {
+        perror("Could not map the given CSV file");
+        exit(EXIT_FAILURE);
+    }
+    madvise((void *)mapping, size, MADV_SEQUENTIAL);
+    const char *const end = mapping + size;
 
-    int max_rows = STANDARD_ROWS_NUMBER;
-    double **result = (double **)calloc(max_rows, sizeof(double *));
-    assert(result);
-
-    char line[MAX_CSV_LINE_LENGTH];
-    int column_indexes[no_of_columns];
-    int rows = 0;
-
-    if (fgets(line, MAX_CSV_LINE_LENGTH, file)) {
-        int i = 0;
-        int j = 0;
-        char *column_name = strtok(line, ",");
-        while (column_name) {
-            if (j < no_of_columns && strcmp(column_name, columns[j]) == 0) {
-                column_indexes[j] = i;
-                j++;
+    // find the requested columns in the column row
+    const char *header_end = memchr(mapping, '\n', size);
+    if (!header_end) {
+        header_end = end;
+    }
+    int num_fields = 1;
+    for (const char *p = mapping; p < header_end; p++) {
+        num_fields += *p == ',';
+    }
+    int slot_of[num_fields];
+    int field_of[no_of_columns];
+    for (int f = 0; f < num_fields; f++) {
+        slot_of[f] = -1;
+    }
+    for (int j = 0; j < no_of_columns; j++) {
+        field_of[j] = -1;
+    }
+    const char *p = mapping;
+    for (int f = 0; f < num_fields; f++) {
+        const char *name_end = field_end(p, header_end);
+        const size_t length =
+            name_end - p - (name_end > p && name_end[-1] == '\r');
+        for (int j = 0; j < no_of_columns; j++) {
+            if (field_of[j] < 0 && strlen(columns[j]) == length &&
+                !memcmp(columns[j], p, length)) {
+                field_of[j] = f;
+                if (slot_of[f] < 0) {
+                    slot_of[f] = j;
+                }
             }
+        }
+        p = name_end + 1;
+    }
+    for (int j = 0; j < no_of_columns; j++) {
+        if (field_of[j] < 0) {
+            fprintf(stderr, "Could not load %s: there is no column %s\n",
+                    filename, columns[j]);
+            exit(EXIT_FAILURE);
+        }
+    }
 
-            i++;
-            column_name = strtok(NULL, ",");
+    // big files are cut into chunks of whole lines that are counted, then
+    // parsed, concurrently, each chunk's rows going to its own place
+    const char *data = header_end < end ? header_end + 1 : end;
+    int num_chunks = 1;
+    if (workers > 1 && size >= PARALLEL_MIN_SIZE) {
+        num_chunks = workers * CHUNKS_PER_WORKER;
+        if ((size_t)num_chunks > size / PARALLEL_MIN_CHUNK) {
+            num_chunks = size / PARALLEL_MIN_CHUNK;
         }
-    } else {
-        perror("Could not read the column row from the given CSV file");
-        exit(EXIT_FAILURE);
+        madvise((void *)mapping, size, MADV_WILLNEED);
     }
+    CsvChunk chunks[num_chunks];
+    num_chunks = split_chunks(data, end, num_chunks, chunks);
+    CsvParse parse = {.chunks = chunks, .slot_of = slot_of,
+                      .num_fields = num_fields};
+    parallel_for(num_chunks, workers, NULL, count_chunk, &parse);
 
-    while (fgets(line, MAX_CSV_LINE_LENGTH, file)) {
-        int current_col = 0;
-        int cell_col = 0;
+    // every line after the column row holds at most one row
+    size_t capacity = 0;
+    for (int k = 0; k < num_chunks; k++) {
+        chunks[k].first_row = capacity;
+        capacity += chunks[k].num_rows;
+        assert(capacity <= INT_MAX);
+    }
 
-        if (rows == max_rows) {
-            result = realloc(result, 2 * max_rows * sizeof(double *));
-            max_rows *= 2;
-        }
+    CsvTable *table =
+        malloc(sizeof(CsvTable) + no_of_columns * sizeof(double *));
+    assert(table);
+    table->num_columns = no_of_columns;
+    table->mapping = NULL;
+    table->mapping_size = 0;
+    // (one more value so that a file without rows still gets a block)
+    table->values = calloc(capacity * no_of_columns + 1, sizeof(double));
+    assert(table->values);
+    for (int j = 0; j < no_of_columns; j++) {
+        table->columns[j] = table->values + j * capacity;
+    }
 
-        result[rows] = (double *)malloc(no_of_columns * sizeof(double));
-        assert(result[rows]);
-        char *current_cell = strtok(line, ",");
-        while (current_cell) {
-            if (current_col < no_of_columns &&
-                cell_col == column_indexes[current_col]) {
-                result[rows][current_col] = strtod(current_cell, NULL);
-                current_col++;
-            }
+    parse.columns = table->columns;
+    parallel_for(num_chunks, workers, NULL, parse_chunk, &parse);
+    munmap((void *)mapping, size);
 
-            cell_col++;
-            current_cell = strtok(NULL, ",");
+    // pack the rows of the chunks and the columns together, in case blank
+    // lines left gaps
+    int rows = 0;
+    for (int k = 0; k < num_chunks; k++) {
+        rows += chunks[k].num_rows;
+    }
+    table->num_rows = rows;
+    for (int j = 0; j < no_of_columns; j++) {
+        double *column = table->values + (size_t)j * rows;
+        const int slot = slot_of[field_of[j]];
+        if (slot != j) {
+            memcpy(column, table->columns[slot], rows * sizeof(double));
+        } else {
+            int row = 0;
+            for (int k = 0; k < num_chunks; k++) {
+                const double *chunk_rows =
+                    table->columns[j] + chunks[k].first_row;
+                if (column + row != chunk_rows) {
+                    memmove(column + row, chunk_rows,
+                            chunks[k].num_rows * sizeof(double));
+                }
+                row += chunks[k].num_rows;
+            }
         }
-
-        rows++;
+        table->columns[j] = column;
     }
 
-    fclose(file);
-    *no_of_rows = rows;
-    return result;
+    return table;
+}
+
+/*
+ * Function: free_csv
+ * ------------------
+ * Frees a table returned by load_csv or map_dataset, unmapping the latter
+ */
+void free_csv(CsvTable *table) {
+    if (table) {
+        if (table->mapping) {
+            munmap(table->mapping, table->mapping_size);
+        }
+        free(table->values);
+        free(table);
+    }
 }
@@ -3,6 +3,7 @@
 #include <stdlib.h>
 #include <float.h>
 #include <stdio.h>
+#include <string.h>
 
 #include "structures.h"
 #include "createstructures.h"
@@ -102,71 +103,202 @@ void rescale(double **matrix, double min, double max, int rows, int index) {
 }
 
 /*
- * Function: format_nn_features
+ * Function: interleave_columns
  * ----------------------------
- * Reformat the given features columns so that each row contains 5 days worth
- * of data making the prediction more accurate at a low "cost".
+ * Lays the given columns out row after row in one block, so that the values
+ * of consecutive rows, and so the days of a window, follow each other.
  *
- * data: data features matrix
+ * columns: one array per column (e.g. the columns of a table loaded by
+ *          load_csv)
  * no_of_rows: number of rows
  * no_of_cols: number of columns
  *
- * return: formatted feautures columns (has to be FREED!)
+ * return: the row-major block, rows[i * no_of_cols + j] being columns[j][i]
+ *         (has to be FREED!)
  */
-double **format_nn_features(double **data, int no_of_rows, int no_of_cols) {
-    double **data_formatted =
-        (double **)calloc(no_of_rows / NO_OF_DAYS, sizeof(double *));
-
-    int row = 0;
-    int col = 0;
-    int data_row = 0;
-    while (data_row < no_of_rows && row < (no_of_rows / NO_OF_DAYS)) {
-        if (!data_formatted[row]) {
-            data_formatted[row] =
-                (double *)calloc(no_of_cols * NO_OF_DAYS, sizeof(double));
+double *interleave_columns(double *const *columns, int no_of_rows,
+                           int no_of_cols) {
+    double *rows = malloc((size_t)no_of_rows * no_of_cols * sizeof(double));
+    assert(rows || no_of_rows == 0);
+    for (int j = 0; j < no_of_cols; ++j) {
+        for (int i = 0; i < no_of_rows; ++i) {
+            rows[(size_t)i * no_of_cols + j] = columns[j][i];
         }
+    }
+    return rows;
+}
 
-        assert(data_formatted[row]);
-
-        for (int i = 0; i < no_of_cols; ++i) {
-            data_formatted[row][col + i] = data[data_row][i];
+/*
+ * Function: normalise_interleaved
+ * -------------------------------
+ * Normalise a row-major block column-wise, in place, like normalise().
+ *
+ * rows: the block, no_of_rows rows of no_of_cols values
+ * no_of_rows: number of rows
+ * no_of_cols: number of columns
+ * min, max: NULL, or arrays of no_of_cols doubles set to the minimum and
+ *           maximum of every column, for the rescale() function
+ */
+void normalise_interleaved(double *rows, int no_of_rows, int no_of_cols,
+                           double *min, double *max) {
+    for (int j = 0; j < no_of_cols; ++j) {
+        double current_min = DBL_MAX;
+        double current_max = -DBL_MAX;
+        for (int i = 0; i < no_of_rows; ++i) {
+            const double value = rows[(size_t)i * no_of_cols + j];
+            current_min = current_min > value ? value : current_min;
+            current_max = current_max < value ? value : current_max;
         }
-
-        data_row++;
-        col += no_of_cols;
-        if ((data_row + 1) % NO_OF_DAYS == 0) {
-            data_row++;
-            row++;
-            col = 0;
+        for (int i = 0; i < no_of_rows; ++i) {
+            double *value = rows + (size_t)i * no_of_cols + j;
+            *value = (*value - current_min) / (current_max - current_min);
+        }
+        if (min && max) {
+            min[j] = current_min;
+            max[j] = current_max;
         }
     }
+}
 
-    return data_formatted;
+/*
+ * Function: count_windows
+ * -----------------------
+ * Returns the number of windows of days rows, each followed by the row of
+ * its target, that fit in no_of_rows rows when a window starts every step
+ * rows.
+ */
+int count_windows(int no_of_rows, int days, int step) {
+    assert(days > 0 && step > 0);
+    return no_of_rows > days ? (no_of_rows - days - 1) / step + 1 : 0;
 }
 
 /*
- * Function: format_targets
- * ------------------------
- * Reformat the target values column so that it includes only every
- * 6th day from that dataset (because of the batching described above).
+ * Function: window_view
+ * ---------------------
+ * Views a row-major block as the feature windows of the network without
+ * copying it: sample i is the days rows starting at row i * step, i.e. the
+ * days * no_of_cols values from rows + i * step * no_of_cols. A step equal
+ * to days + 1 gives the disjoint blocks of days + 1 rows of the first
+ * versions,
+ * while a step of 1 makes every row but the first days the target of a
+ * window.
  *
- * targets: target values matrix where the actual values or on the first column
- * no_of_rows: number of rows
+ * rows: the block, no_of_rows rows of no_of_cols values
+ * days: the number of rows in a window
+ * step: the number of rows between the starts of consecutive windows
+ */
+SampleView window_view(double *rows, int no_of_rows, int no_of_cols, int days,
+                       int step) {
+    SampleView view = {.base = rows,
+                       .stride = step * no_of_cols,
+                       .num_samples = count_windows(no_of_rows, days, step)};
+    return view;
+}
+
+/*
+ * Function: target_view
+ * ---------------------
+ * Views the targets of the windows of window_view without copying them:
+ * sample i is the single value in column index of the row just after
+ * window i.
+ */
+SampleView target_view(double *rows, int no_of_rows, int no_of_cols,
+                       int index, int days, int step) {
+    SampleView view = {.base = rows + (size_t)days * no_of_cols + index,
+                       .stride = step * no_of_cols,
+                       .num_samples = count_windows(no_of_rows, days, step)};
+    return view;
+}
+
+/*
+ * Function: view_rows
+ * -------------------
+ * Returns one pointer per sample of the view, into the viewed block, to be
+ * passed as the rows of inputs or targets (train, cost, ...) without any
+ * value being copied.
  *
- * return: formatted target values (has to be FREED!)
+ * return: the pointers (has to be FREED, with free() alone!)
  */
-double **format_targets(double **targets, int no_of_rows) {
-    double **targets_formatted =
-        (double **)calloc(no_of_rows / NO_OF_DAYS, sizeof(double *));
-
-    int targets_row = 5;
-    while (targets_row < (no_of_rows / NO_OF_DAYS) * NO_OF_DAYS) {
-        targets_formatted[targets_row / NO_OF_DAYS] =
-            (double *)calloc(1, sizeof(double));
-        targets_formatted[targets_row / NO_OF_DAYS][0] =
-            targets[targets_row][0];
-        targets_row += 6;
+double **view_rows(SampleView view) {
+    double **rows = malloc((view.num_samples + 1) * sizeof(double *));
+    assert(rows);
+    for (int i = 0; i < view.num_samples; ++i) {
+        rows[i] = view.base + (size_t)i * view.stride;
     }
+    return rows;
+}
+
+/*
+ * Function: parse_window
+ * ----------------------
+ * Sets up a window of the given number of days over the columns named in
+ * a comma separated list, e.g. DEFAULT_WINDOW_COLUMNS. Returns false if
+ * days is not positive, there are no columns or more than
+ * WINDOW_MAX_COLUMNS, a name is empty or too long, or WINDOW_TARGET is
+ * not one of them.
+ */
+bool parse_window(Window *window, int days, const char *columns) {
+    assert(window && columns);
+    memset(window, 0, sizeof(Window));
+    window->days = days;
+    window->target = -1;
+
+    const char *name = columns;
+    for (;;) {
+        const char *end = strchr(name, ',');
+        const size_t length = end ? (size_t)(end - name) : strlen(name);
+        if (length == 0 || length >= WINDOW_COLUMN_NAME_SIZE ||
+            window->num_columns == WINDOW_MAX_COLUMNS) {
+            return false;
+        }
+        char *column = window->columns[window->num_columns];
+        memcpy(column, name, length);
+        column[length] = '\0';
+        if (window->target < 0 && !strcmp(column, WINDOW_TARGET)) {
+            window->target = window->num_columns;
+        }
+        window->num_columns++;
+        if (!end) {
+            break;
+        }
+        name = end + 1;
+    }
+    return days > 0 && window->target >= 0;
+}
 
-    return targets_formatted;
+/*
+ * Function: window_for_inputs
+ * ---------------------------
+ * Sets up the window of a network saved without one (CSV networks and the
+ * first binary models), which always took whole days of
+ * DEFAULT_WINDOW_COLUMNS. Returns false if num_inputs is not a whole
+ * number of such days.
+ */
+bool window_for_inputs(Window *window, int num_inputs) {
+    Window columns;
+    parse_window(&columns, 1, DEFAULT_WINDOW_COLUMNS);
+    return num_inputs > 0 && num_inputs % columns.num_columns == 0 &&
+           parse_window(window, num_inputs / columns.num_columns,
+                        DEFAULT_WINDOW_COLUMNS);
+}
+
+/*
+ * Function: window_features
+ * -------------------------
+ * Returns the number of inputs of a network taking the window
+ */
+int window_features(const Window *window) {
+    return window->days * window->num_columns;
+}
+
+/*
+ * Function: window_column_names
+ * -----------------------------
+ * Fills names with the num_columns names of the columns of the window, as
+ * taken by load_dataset. They point into the window.
+ */
+void window_column_names(const Window *window, const char **names) {
+    for (int j = 0; j < window->num_columns; ++j) {
+        names[j] = window->columns[j];
+    }
 }
@@ -0,0 +1,336 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <limits.h>
+#include <assert.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "csv.h"
+#include "dataset.h"
+
+#define DATASET_MAGIC "GSDS"
+#define DATASET_VERSION 1
+#define DATASET_EXTENSION ".gsd"
+#define DATASET_ALIGNMENT 64
+
+/*
+ * A dataset is a native endian binary file holding columns parsed from a
+ * CSV, laid out so that it can be mapped and used in place:
+ * 1. the header below, which records the size and modification time of
+ *    the CSV it was converted from
+ * 2. the names of the columns, each terminated by a NUL
+ * 3. every column, num_rows values of value_size bytes
+ * Each column starts on a multiple of DATASET_ALIGNMENT, the gaps being
+ * filled with zeros.
+ */
+typedef struct dataset_header {
+    char magic[4];
+    uint32_t version;
+    uint32_t value_size;
+    uint32_t num_columns;
+    uint64_t num_rows;
+    uint64_t names_size;
+    uint64_t source_size;
+    int64_t source_mtime;
+    int64_t source_mtime_nsec;
+} DatasetHeader;
+
+static size_t align_offset(size_t offset) {
+    return (offset + DATASET_ALIGNMENT - 1) &
+           ~(size_t)(DATASET_ALIGNMENT - 1);
+}
+
+static bool write_block(FILE *file, const void *block, size_t size,
+                        size_t *offset) {
+    static const char zeros[DATASET_ALIGNMENT];
+    const size_t padding = align_offset(*offset + size) - (*offset + size);
+    *offset += size + padding;
+    return (!size || fwrite(block, size, 1, file) == 1) &&
+           (!padding || fwrite(zeros, padding, 1, file) == 1);
+}
+
+/*
+ * Function: write_dataset
+ * -----------------------
+ * Writes the table to filename in the dataset format, the jth column being
+ * named columns[j]. The file is written next to filename and renamed over
+ * it once complete, so a dataset is never seen half written. Returns false
+ * if the file could not be written.
+ */
+static bool write_dataset(const CsvTable *table, const char **columns,
+                          const struct stat *source, const char *filename) {
+    const size_t length = strlen(filename) + 32;
+    char temporary[length];
+    snprintf(temporary, length, "%s.%ld.tmp", filename, (long)getpid());
+    FILE *file = fopen(temporary, "wb");
+    if (file == NULL) {
+        return false;
+    }
+
+    DatasetHeader header = {.version = DATASET_VERSION,
+                            .value_size = sizeof(double),
+                            .num_columns = table->num_columns,
+                            .num_rows = table->num_rows,
+                            .source_size = source->st_size,
+                            .source_mtime = source->st_mtim.tv_sec,
+                            .source_mtime_nsec = source->st_mtim.tv_nsec};
+    memcpy(header.magic, DATASET_MAGIC, 4);
+    for (int j = 0; j < table->num_columns; j++) {
+        header.names_size += strlen(columns[j]) + 1;
+    }
+
+    size_t offset = sizeof(header) + header.names_size;
+    bool written = fwrite(&header, sizeof(header), 1, file) == 1;
+    for (int j = 0; j < table->num_columns; j++) {
+        written = written &&
+                  fwrite(columns[j], strlen(columns[j]) + 1, 1, file) == 1;
+    }
+    // pads the names
+    written = written && write_block(file, NULL, 0, &offset);
+    for (int j = 0; j < table->num_columns; j++) {
+        written = written &&
+                  write_block(file, table->columns[j],
+                              (size_t)table->num_rows * sizeof(double),
+                              &offset);
+    }
+
+    if (fclose(file) || !written || rename(temporary, filename)) {
+        remove(temporary);
+        return false;
+    }
+    return true;
+}
+
+/*
+ * Function: view_dataset
+ * ----------------------
+ * Checks that the mapping holds a dataset with all the given columns, and
+ * returns a table whose columns point into it. Returns NULL and sets reason
+ * otherwise.
+ */
+static CsvTable *view_dataset(void *mapping, size_t size,
+                              const char **columns, int no_of_columns,
+                              const char **reason) {
+    const DatasetHeader *header = mapping;
+    if (size < sizeof(DatasetHeader) ||
+        memcmp(header->magic, DATASET_MAGIC, 4) ||
+        header->version != DATASET_VERSION) {
+        *reason = "unknown format";
+        return NULL;
+    }
+    if (header->value_size != sizeof(double)) {
+        *reason = "unknown type of values";
+        return NULL;
+    }
+    const uint64_t num_rows = header->num_rows;
+    const uint64_t num_columns = header->num_columns;
+    if (num_rows > INT_MAX || num_columns > size ||
+        header->names_size > size ||
+        align_offset(sizeof(DatasetHeader) + header->names_size) +
+                num_columns * align_offset(num_rows * sizeof(double)) !=
+            size) {
+        *reason = "size does not match its columns";
+        return NULL;
+    }
+
+    // find the offset of every requested column from its name
+    const char *names = (const char *)(header + 1);
+    const char *names_end = names + header->names_size;
+    const size_t first_column =
+        align_offset(sizeof(DatasetHeader) + header->names_size);
+    size_t offsets[no_of_columns];
+    for (int j = 0; j < no_of_columns; j++) {
+        offsets[j] = 0;
+    }
+    const char *name = names;
+    for (uint64_t k = 0; k < num_columns; k++) {
+        const char *name_end = memchr(name, '\0', names_end - name);
+        if (name_end == NULL) {
+            *reason = "bad column names";
+            return NULL;
+        }
+        for (int j = 0; j < no_of_columns; j++) {
+            if (!offsets[j] && !strcmp(columns[j], name)) {
+                offsets[j] =
+                    first_column + k * align_offset(num_rows * sizeof(double));
+            }
+        }
+        name = name_end + 1;
+    }
+    for (int j = 0; j < no_of_columns; j++) {
+        if (!offsets[j]) {
+            *reason = "a column is missing";
+            return NULL;
+        }
+    }
+
+    CsvTable *table =
+        malloc(sizeof(CsvTable) + no_of_columns * sizeof(double *));
+    assert(table);
+    table->num_rows = num_rows;
+    table->num_columns = no_of_columns;
+    table->values = NULL;
+    table->mapping = mapping;
+    table->mapping_size = size;
+    for (int j = 0; j < no_of_columns; j++) {
+        table->columns[j] = (double *)((char *)mapping + offsets[j]);
+    }
+    return table;
+}
+
+// maps the whole file, returns NULL if it cannot be opened or is empty
+static void *map_file(const char *filename, struct stat *info) {
+    const int fd = open(filename, O_RDONLY);
+    if (fd < 0) {
+        return NULL;
+    }
+    void *mapping = MAP_FAILED;
+    if (!fstat(fd, info) && info->st_size > 0) {
+        mapping = mmap(NULL, info->st_size, PROT_READ | PROT_WRITE,
+                       MAP_PRIVATE, fd, 0);
+    }
+    close(fd);
+    return mapping == MAP_FAILED ? NULL : mapping;
+}
+
+/*
+ * Function: convert_csv
+ * ---------------------
+ * Parameters:	csv_filename - a CSV in the format produced by Yahoo Finance
+ *              filename - the name of the dataset that will be saved to
+ *              columns - the names of the columns to convert
+ *              no_of_columns - the number of columns to convert
+ *              workers - maximum number of threads parsing the CSV
+ *
+ * Parses the given columns of the CSV once and saves them as a dataset
+ * that map_dataset loads without parsing. Returns false if the dataset
+ * could not be written.
+ */
+bool convert_csv(const char *csv_filename, const char *filename,
+                 const char **columns, int no_of_columns, int workers) {
+    assert(csv_filename != NULL && filename != NULL);
+    struct stat source;
+    if (stat(csv_filename, &source)) {
+        perror("Could not open the given CSV file");
+        exit(EXIT_FAILURE);
+    }
+    CsvTable *table = load_csv(csv_filename, columns, no_of_columns, workers);
+    const bool written = write_dataset(table, columns, &source, filename);
+    free_csv(table);
+    return written;
+}
+
+/*
+ * Function: is_dataset_file
+ * -------------------------
+ * Returns true iff the file starts like a dataset
+ */
+bool is_dataset_file(const char *filename) {
+    assert(filename != NULL);
+    FILE *file = fopen(filename, "rb");
+    if (file == NULL) {
+        return false;
+    }
+    char magic[4];
+    const bool dataset =
+        fread(magic, 4, 1, file) == 1 && !memcmp(magic, DATASET_MAGIC, 4);
+    fclose(file);
+    return dataset;
+}
+
+/*
+ * Function: map_dataset
+ * ---------------------
+ * Parameters:	filename - a dataset written by convert_csv
+ *              columns - the names of the columns to load, in any order
+ *              no_of_columns - the number of columns to load
+ *
+ * Maps the dataset into memory and returns a table whose columns point
+ * straight into the mapping, so nothing is parsed or copied. The mapping
+ * is private: writing to the columns never changes the file. free_csv
+ * unmaps it.
+ */
+CsvTable *map_dataset(const char *filename, const char **columns,
+                      int no_of_columns) {
+    assert(filename != NULL && columns != NULL);
+    struct stat info;
+    void *mapping = map_file(filename, &info);
+    if (mapping == NULL) {
+        perror("Could not map the dataset");
+        exit(EXIT_FAILURE);
+    }
+    const char *reason;
+    CsvTable *table =
+        view_dataset(mapping, info.st_size, columns, no_of_columns, &reason);
+    if (table == NULL) {
+        fprintf(stderr, "%s is not a valid dataset: %s\n", filename, reason);
+        exit(EXIT_FAILURE);
+    }
+    return table;
+}
+
+/*
+ * Function: load_dataset
+ * ----------------------
+ * Parameters:	filename - a CSV, or a dataset written by convert_csv
+ *              columns - the names of the columns to load, in any order
+ *              no_of_columns - the number of columns to load
+ *              workers - maximum number of threads parsing a CSV
+ *
+ * Loads the columns from either format. A CSV is cached as a dataset next
+ * to it (data.csv in data.gsd): as long as the size and modification time
+ * of the CSV are those recorded in the cache, and the cache has all the
+ * columns, the cache is mapped instead of parsing the CSV. Otherwise the
+ * CSV is parsed and the cache written again, with the columns asked for.
+ * If the cache cannot be written the CSV is still loaded.
+ */
+CsvTable *load_dataset(const char *filename, const char **columns,
+                       int no_of_columns, int workers) {
+    assert(filename != NULL);
+    if (is_dataset_file(filename)) {
+        return map_dataset(filename, columns, no_of_columns);
+    }
+
+    struct stat source;
+    if (stat(filename, &source)) {
+        perror("Could not open the given CSV file");
+        exit(EXIT_FAILURE);
+    }
+
+    const size_t length = strlen(filename);
+    const size_t stem = length >= 4 && !strcmp(filename + length - 4, ".csv")
+                            ? length - 4
+                            : length;
+    char cache[stem + sizeof(DATASET_EXTENSION)];
+    memcpy(cache, filename, stem);
+    strcpy(cache + stem, DATASET_EXTENSION);
+
+    struct stat info;
+    void *mapping = map_file(cache, &info);
+    if (mapping) {
+        const DatasetHeader *header = mapping;
+        const char *reason;
+        CsvTable *table = NULL;
+        if ((size_t)info.st_size >= sizeof(DatasetHeader) &&
+            header->source_size == (uint64_t)source.st_size &&
+            header->source_mtime == source.st_mtim.tv_sec &&
+            header->source_mtime_nsec == source.st_mtim.tv_nsec) {
+            table = view_dataset(mapping, info.st_size, columns,
+                                 no_of_columns, &reason);
+        }
+        if (table) {
+            return table;
+        }
+        munmap(mapping, info.st_size);
+    }
+
+    CsvTable *table = load_csv(filename, columns, no_of_columns, workers);
+    if (!write_dataset(table, columns, &source, cache)) {
+        fprintf(stderr, "Could not cache %s in %s\n", filename, cache);
+    }
+    return table;
+}
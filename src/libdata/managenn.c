@@ -4,6 +4,7 @@
 
 #include "structures.h"
 #include "dataops.h"
+#include "managenn.h"
 #include "assert.h"
 
 /*
@@ -27,6 +28,26 @@ MLP *load_net(const char *filename, double *min, double *max) {
         exit(EXIT_FAILURE);
     }
 
+    MLP *mlp_net = read_net(file, min, max);
+    fclose(file);
+    return mlp_net;
+}
+
+/*
+ * Function: read_net
+ * ------------------
+ * Parameters:	file - stream positioned at the start of a network in the
+ *					   format written by save_nn
+ *              min, max - pointers to hold the minimum and maximum of the
+ *                         training targets
+ *
+ * Reads one network from the stream, leaving it positioned just after the
+ * network's last line.
+ */
+MLP *read_net(FILE *file, double *min, double *max) {
+    assert(file != NULL);
+    // strtok_r rather than strtok, as threads may read networks at once
+    char *save;
     //Read the first line
     char c = fgetc(file);
     int count = 0;
@@ -34,17 +55,18 @@ MLP *load_net(const char *filename, double *min, double *max) {
     char *buf = calloc(buffer_size + 1, sizeof(char));
     while ((c != EOF) && (c != '\n')) {
         if (count >= buffer_size - 1) {
-            buffer_size *= 1;
+            buffer_size *= 2;
             buf = realloc(buf, buffer_size);
         }
         buf[count] = c;
         c = fgetc(file);
         count++;
     }
+    buf[count] = '\0';
 
     //Set the min and max values
-    *min = atof(strtok(buf, ","));
-    *max = atof(strtok(NULL, ","));
+    *min = atof(strtok_r(buf, ",", &save));
+    *max = atof(strtok_r(NULL, ",", &save));
     free(buf);
 
     //Read the second line
@@ -66,7 +88,7 @@ MLP *load_net(const char *filename, double *min, double *max) {
     strncpy(layers, buf, count);
     layers[count] = 0;
 
-    char *token = strtok(layers, ",");
+    char *token = strtok_r(layers, ",", &save);
     int num_layers = 0;
     int n = 0;
     int *num_nodes = malloc(num_layers * sizeof(int));
@@ -76,12 +98,12 @@ MLP *load_net(const char *filename, double *min, double *max) {
             num_nodes = realloc(num_nodes, num_layers * sizeof(int));
         }
         num_nodes[n++] = atoi(token);
-        token = strtok(NULL, ",");
+        token = strtok_r(NULL, ",", &save);
     }
     free(buf);
 
-    //Initialise an MLP with the correct number of layers and nodes
-    MLP *mlp_net = mlp_initialise(num_nodes, num_layers);
+    //Create an MLP with the correct number of layers and nodes
+    MLP *mlp_net = mlp_create(num_nodes, num_layers);
 
     free(num_nodes);
 
@@ -107,13 +129,13 @@ MLP *load_net(const char *filename, double *min, double *max) {
         strncpy(weights, line, count);
         weights[count] = 0;
         //Assign the weights for each layer
-        char *weight_tok = strtok(weights, ",");
+        char *weight_tok = strtok_r(weights, ",", &save);
         int j;
         int k;
         for (j = 0; j < layer->num_outputs; j++) {
             for (k = 0; k < layer->num_inputs; k++) {
-                layer->weights[k][j] = atof(weight_tok);
-                weight_tok = strtok(NULL, ",");
+                LAYER_WEIGHT(layer, k, j) = atof(weight_tok);
+                weight_tok = strtok_r(NULL, ",", &save);
             }
         }
         layer = layer->next_layer;
@@ -137,19 +159,19 @@ MLP *load_net(const char *filename, double *min, double *max) {
             c = fgetc(file);
             count++;
         }
+        line[count] = '\0';
 
         //Assign the biases for each layer
-        char *biases = strtok(line, ",");
+        char *biases = strtok_r(line, ",", &save);
         int j;
         for (j = 0; j < layer->num_outputs; j++) {
             layer->biases[j] = atof(biases);
-            biases = strtok(NULL, ",");
+            biases = strtok_r(NULL, ",", &save);
         }
         layer = layer->next_layer;
         free(line);
     }
 
-    fclose(file);
     return mlp_net;
 }
 
@@ -170,10 +192,34 @@ MLP *load_net(const char *filename, double *min, double *max) {
 void save_nn(Chromosome *c, char name[], double **targets, int no_targets) {
     FILE *nn;
     nn = fopen(name, "w+");
+    if (nn == NULL) {
+        perror("Could not open the file to save the network to");
+        exit(EXIT_FAILURE);
+    }
+
+    write_nn(nn, c, get_min(targets, no_targets, 0),
+             get_max(targets, no_targets, 0));
+    fclose(nn);
+}
+
+/*
+ * Function: write_nn
+ * ------------------
+ * Parameters:	nn - stream the network is written to
+ *				c - chromosome that contains the mlp to be saved
+ *				min, max - the minimum and maximum of the training targets
+ *
+ * Writes the network of the chromosome to the stream in the format
+ * described in save_nn.
+ */
+void write_nn(FILE *nn, const Chromosome *c, double min, double max) {
+    assert(nn != NULL && c != NULL);
+
+    // Numbers are printed with 17 significant digits, enough to read them
+    // back exactly, so that migrants keep their trained weights
 
     // Print the min and max value in that order
-    fprintf(nn, "%lf,%lf\n", get_min(targets, no_targets, 0),
-            get_max(targets, no_targets, 0));
+    fprintf(nn, "%.17g,%.17g\n", min, max);
 
     // Print no. nodes in each layer
     fprintf(nn, "%i,", c->mlp->input_layer->num_outputs);
@@ -189,9 +235,9 @@ void save_nn(Chromosome *c, char name[], double **targets, int no_targets) {
             for (int i = 0; i < curr->num_inputs; i++) {
                 if ((j == curr->num_outputs - 1) &&
                     (i == curr->num_inputs - 1)) {
-                    fprintf(nn, "%lf", curr->weights[i][j]);
+                    fprintf(nn, "%.17g", LAYER_WEIGHT(curr, i, j));
                 } else {
-                    fprintf(nn, "%lf,", curr->weights[i][j]);
+                    fprintf(nn, "%.17g,", LAYER_WEIGHT(curr, i, j));
                 }
             }
         }
@@ -204,14 +250,12 @@ void save_nn(Chromosome *c, char name[], double **targets, int no_targets) {
     while (curr) {
         for (int j = 0; j < curr->num_outputs; j++) {
             if (j == curr->num_outputs - 1) {
-                fprintf(nn, "%lf", curr->biases[j]);
+                fprintf(nn, "%.17g", curr->biases[j]);
             } else {
-                fprintf(nn, "%lf,", curr->biases[j]);
+                fprintf(nn, "%.17g,", curr->biases[j]);
             }
         }
         fprintf(nn, "\n");
         curr = curr->next_layer;
     }
-
-    fclose(nn);
 }
@@ -0,0 +1,502 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <assert.h>
+#include <pthread.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+
+#include "structures.h"
+#include "createstructures.h"
+#include "selection.h"
+#include "pool.h"
+#include "managenn.h"
+#include "migration.h"
+
+/*
+ * Function: parse_topology
+ * ------------------------
+ * Sets topology to the topology called name ("ring" or "full"), returns
+ * false if there is no such topology.
+ */
+bool parse_topology(const char *name, MigrationTopology *topology) {
+    if (strcmp(name, "ring") == 0) {
+        *topology = TOPOLOGY_RING;
+    } else if (strcmp(name, "full") == 0) {
+        *topology = TOPOLOGY_FULL;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+/*
+ * Function: sends_to
+ * ------------------
+ * Returns true if island from sends migrants to island to.
+ */
+static bool sends_to(MigrationTopology topology, int num_islands, int from,
+                     int to) {
+    if (from == to) {
+        return false;
+    }
+    if (topology == TOPOLOGY_RING) {
+        return to == (from + 1) % num_islands;
+    }
+    return true;
+}
+
+static void close_socket(int fd) {
+    if (fd >= 0) {
+        close(fd);
+    }
+}
+
+/*
+ * Function: create_islands
+ * ------------------------
+ * Forks the process into num_islands islands, linked by UNIX sockets
+ * according to the topology, and returns the island of the calling process.
+ * Every island must run the genetic algorithm with the same number of
+ * generations and call migrate and gather_fittest at the same points.
+ *
+ * num_islands: the number of islands, including the calling process
+ * topology: which islands send migrants to which
+ * interval: the number of generations between two migrations
+ * migrants: the number of individuals sent to each neighbour per migration
+ */
+Island *create_islands(int num_islands, MigrationTopology topology,
+                       int interval, int migrants) {
+    assert(num_islands > 0);
+    assert(interval > 0);
+    assert(migrants > 0);
+
+    // links[i * num_islands + j] is the end of the socket between i and j
+    // that belongs to island i
+    const int n = num_islands;
+    int *links = malloc(n * n * sizeof(int));
+    int *results = malloc(n * sizeof(int));
+    int *child_results = malloc(n * sizeof(int));
+    pid_t *children = calloc(n, sizeof(pid_t));
+    assert(links && results && child_results && children);
+    for (int i = 0; i < n * n; ++i) {
+        links[i] = -1;
+    }
+    for (int i = 0; i < n; ++i) {
+        results[i] = child_results[i] = -1;
+    }
+
+    int sockets[2];
+    for (int i = 0; i < n; ++i) {
+        for (int j = i + 1; j < n; ++j) {
+            if (sends_to(topology, n, i, j) || sends_to(topology, n, j, i)) {
+                if (socketpair(AF_UNIX, SOCK_STREAM, 0, sockets)) {
+                    perror("Could not create a migration socket");
+                    exit(EXIT_FAILURE);
+                }
+                links[i * n + j] = sockets[0];
+                links[j * n + i] = sockets[1];
+            }
+        }
+    }
+    for (int i = 1; i < n; ++i) {
+        if (socketpair(AF_UNIX, SOCK_STREAM, 0, sockets)) {
+            perror("Could not create a result socket");
+            exit(EXIT_FAILURE);
+        }
+        results[i] = sockets[0];
+        child_results[i] = sockets[1];
+    }
+
+    // a peer exiting early should be reported as an error, not kill us
+    signal(SIGPIPE, SIG_IGN);
+
+    // anything still buffered would otherwise be printed by every island
+    fflush(stdout);
+    fflush(stderr);
+
+    int id = 0;
+    for (int i = 1; i < n; ++i) {
+        const pid_t pid = fork();
+        if (pid < 0) {
+            perror("Could not start an island");
+            exit(EXIT_FAILURE);
+        }
+        if (pid == 0) {
+            id = i;
+            break;
+        }
+        children[i] = pid;
+    }
+
+    Island *island = calloc(1, sizeof(Island));
+    assert(island);
+    island->id = id;
+    island->num_islands = n;
+    island->topology = topology;
+    island->interval = interval;
+    island->migrants = migrants;
+    island->peers = malloc(n * sizeof(int));
+    assert(island->peers);
+
+    // keep this island's ends of the sockets, close everything else
+    for (int i = 0; i < n; ++i) {
+        for (int j = 0; j < n; ++j) {
+            if (i == id) {
+                island->peers[j] = links[i * n + j];
+            } else {
+                close_socket(links[i * n + j]);
+            }
+        }
+    }
+    free(links);
+
+    if (id == 0) {
+        for (int i = 1; i < n; ++i) {
+            close_socket(child_results[i]);
+        }
+        island->results = results;
+        island->children = children;
+    } else {
+        for (int i = 1; i < n; ++i) {
+            close_socket(results[i]);
+            if (i != id) {
+                close_socket(child_results[i]);
+            }
+        }
+        results[0] = child_results[id];
+        for (int i = 1; i < n; ++i) {
+            results[i] = -1;
+        }
+        island->results = results;
+        free(children);
+    }
+    free(child_results);
+
+    return island;
+}
+
+/*
+ * Function: migration_due
+ * -----------------------
+ * Returns true if migrants should be exchanged after the given generation
+ * has been trained.
+ */
+bool migration_due(const Island *island, int generation_number) {
+    return island && island->num_islands > 1 &&
+           (generation_number + 1) % island->interval == 0;
+}
+
+static void write_all(int fd, const void *buf, size_t len) {
+    const char *p = buf;
+    while (len > 0) {
+        const ssize_t written = write(fd, p, len);
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            perror("Could not send to another island");
+            exit(EXIT_FAILURE);
+        }
+        p += written;
+        len -= written;
+    }
+}
+
+static void read_all(int fd, void *buf, size_t len) {
+    char *p = buf;
+    while (len > 0) {
+        const ssize_t got = read(fd, p, len);
+        if (got < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            perror("Could not receive from another island");
+            exit(EXIT_FAILURE);
+        }
+        if (got == 0) {
+            fprintf(stderr, "Another island exited during migration\n");
+            exit(EXIT_FAILURE);
+        }
+        p += got;
+        len -= got;
+    }
+}
+
+/*
+ * Function: send_message
+ * ----------------------
+ * Sends the length of the message followed by the message itself.
+ */
+static void send_message(int fd, const char *message, size_t len) {
+    const uint64_t header = len;
+    write_all(fd, &header, sizeof(header));
+    write_all(fd, message, len);
+}
+
+/*
+ * Function: receive_message
+ * -------------------------
+ * Returns a heap-allocated copy of the next message on the socket, setting
+ * len to its length.
+ */
+static char *receive_message(int fd, size_t *len) {
+    uint64_t header;
+    read_all(fd, &header, sizeof(header));
+    char *message = malloc(header > 0 ? header : 1);
+    assert(message);
+    read_all(fd, message, header);
+    *len = header;
+    return message;
+}
+
+/*
+ * typedef struct: outgoing_message
+ * --------------------------------
+ * A message being sent on its own thread, so that two islands sending each
+ * other networks larger than the socket buffers cannot block each other.
+ */
+typedef struct outgoing_message {
+    int fd;
+    const char *message;
+    size_t len;
+    pthread_t thread;
+} OutgoingMessage;
+
+static void *send_job(void *arg) {
+    OutgoingMessage *outgoing = arg;
+    send_message(outgoing->fd, outgoing->message, outgoing->len);
+    return NULL;
+}
+
+/*
+ * Function: serialise_chromosomes
+ * -------------------------------
+ * Writes the number of chromosomes, then for each of them its learning
+ * rate and the number of epochs it was trained for followed by its network
+ * in the save_nn format, into a heap-allocated buffer.
+ */
+char *serialise_chromosomes(Chromosome **chromosomes, int count,
+                            size_t *len) {
+    char *message = NULL;
+    FILE *stream = open_memstream(&message, len);
+    if (!stream) {
+        perror("Could not serialise the migrants");
+        exit(EXIT_FAILURE);
+    }
+    fprintf(stream, "%d\n", count);
+    for (int i = 0; i < count; ++i) {
+        fprintf(stream, "%.17g %d\n", chromosomes[i]->learning_rate,
+                chromosomes[i]->epochs_trained);
+        write_nn(stream, chromosomes[i], 0, 0);
+    }
+    fclose(stream);
+    return message;
+}
+
+/*
+ * Function: deserialise_chromosomes
+ * ---------------------------------
+ * Reads back the chromosomes written by serialise_chromosomes, adding them
+ * to the end of chromosomes, and returns how many there were.
+ */
+int deserialise_chromosomes(char *message, size_t len,
+                            Chromosome **chromosomes) {
+    FILE *stream = fmemopen(message, len, "r");
+    if (!stream) {
+        perror("Could not read the migrants");
+        exit(EXIT_FAILURE);
+    }
+    int count;
+    if (fscanf(stream, "%d ", &count) != 1) {
+        fprintf(stderr, "Malformed migration message\n");
+        exit(EXIT_FAILURE);
+    }
+    for (int i = 0; i < count; ++i) {
+        double learning_rate, min, max;
+        int epochs_trained;
+        if (fscanf(stream, "%lf %d ", &learning_rate, &epochs_trained) != 2) {
+            fprintf(stderr, "Malformed migration message\n");
+            exit(EXIT_FAILURE);
+        }
+        MLP *mlp = read_net(stream, &min, &max);
+
+        int layers = 0;
+        for (Layer *l = mlp->input_layer; l; l = l->next_layer) {
+            ++layers;
+        }
+        Chromosome *chromosome = create_chromosome();
+        chromosome->learning_rate = learning_rate;
+        chromosome->epochs_trained = epochs_trained;
+        chromosome->hidden_layers = layers - 2;
+        chromosome->nodes_per_layer = mlp->input_layer->next_layer->num_outputs;
+        chromosome->mlp = mlp;
+        assert(chromosome->hidden_layers >= HIDDEN_LAYERS_LOWER &&
+               chromosome->hidden_layers <= HIDDEN_LAYERS_UPPER);
+        chromosomes[i] = chromosome;
+    }
+    fclose(stream);
+    return count;
+}
+
+/*
+ * Function: migrate
+ * -----------------
+ * Exchanges the fittest individuals of the trained current generation with
+ * the neighbouring islands. The generation is evaluated and its best
+ * island->migrants individuals are copied to every island this one sends
+ * to, while the migrants of the islands sending to this one replace the
+ * worst individuals, up to half of the population. The newcomers are
+ * evaluated locally by calculate_fittest like everyone else.
+ *
+ * island: the island of this process
+ * state: state whose current generation takes part in the migration
+ * targets, inputs, no_inputs: the rows the generation is ranked on
+ */
+void migrate(Island *island, GeneticState *state, double **targets,
+             double **inputs, int no_inputs) {
+    assert(island && state);
+    Generation *generation = state->current_generation;
+    const int size = generation->population_size;
+    const int n = island->num_islands;
+
+    evaluate_population(state, generation->population, size, targets, inputs,
+                        no_inputs);
+    Chromosome **ranking = malloc(size * sizeof(Chromosome *));
+    assert(ranking);
+    memcpy(ranking, generation->population, size * sizeof(Chromosome *));
+    rank_population(ranking, size);
+
+    const int migrants = island->migrants < size ? island->migrants : size;
+    size_t len;
+    char *message = serialise_chromosomes(ranking, migrants, &len);
+
+    OutgoingMessage *outgoing = malloc(n * sizeof(OutgoingMessage));
+    assert(outgoing);
+    for (int j = 0; j < n; ++j) {
+        if (sends_to(island->topology, n, island->id, j)) {
+            outgoing[j] = (OutgoingMessage){.fd = island->peers[j],
+                                            .message = message,
+                                            .len = len};
+            if (pthread_create(&outgoing[j].thread, NULL, send_job,
+                               &outgoing[j])) {
+                perror("Could not create a migration thread");
+                exit(EXIT_FAILURE);
+            }
+        }
+    }
+
+    // every neighbour sends the same number of migrants
+    Chromosome **immigrants = malloc(n * migrants * sizeof(Chromosome *));
+    assert(immigrants);
+    int received = 0;
+    for (int j = 0; j < n; ++j) {
+        if (sends_to(island->topology, n, j, island->id)) {
+            size_t incoming_len;
+            char *incoming = receive_message(island->peers[j], &incoming_len);
+            received +=
+                deserialise_chromosomes(incoming, incoming_len,
+                                        immigrants + received);
+            free(incoming);
+        }
+    }
+
+    for (int j = 0; j < n; ++j) {
+        if (sends_to(island->topology, n, island->id, j)) {
+            pthread_join(outgoing[j].thread, NULL);
+        }
+    }
+    free(outgoing);
+    free(message);
+
+    // the newcomers take the places of the worst individuals
+    int replaced = 0;
+    for (int k = size - 1; k >= size - size / 2 && replaced < received; --k) {
+        for (int i = 0; i < size; ++i) {
+            if (generation->population[i] == ranking[k]) {
+                pool_release(state->pool, generation->population[i]);
+                generation->population[i] = immigrants[replaced++];
+                break;
+            }
+        }
+    }
+    for (int i = replaced; i < received; ++i) {
+        free_chromosome(immigrants[i]);
+    }
+    free(immigrants);
+    free(ranking);
+}
+
+/*
+ * Function: gather_fittest
+ * ------------------------
+ * Called by every island once the algorithm is over. The other islands send
+ * their fittest individual to island 0, which evaluates them and keeps the
+ * fittest of all as its state->fittest_individual.
+ *
+ * island: the island of this process
+ * state: the final state of the island
+ * targets, inputs, no_inputs: the rows the individuals are compared on
+ */
+void gather_fittest(Island *island, GeneticState *state, double **targets,
+                    double **inputs, int no_inputs) {
+    assert(island && state && state->fittest_individual);
+
+    if (island->id != 0) {
+        size_t len;
+        char *message =
+            serialise_chromosomes(&state->fittest_individual, 1, &len);
+        send_message(island->results[0], message, len);
+        free(message);
+        return;
+    }
+
+    for (int i = 1; i < island->num_islands; ++i) {
+        size_t len;
+        char *message = receive_message(island->results[i], &len);
+        Chromosome *chromosome;
+        deserialise_chromosomes(message, len, &chromosome);
+        free(message);
+
+        chromosome->fitness = state->fitness_function(chromosome->mlp, targets,
+                                                      inputs, no_inputs);
+        if (chromosome->fitness > state->fittest_individual->fitness) {
+            pool_release(state->pool, state->fittest_individual);
+            state->fittest_individual = chromosome;
+        } else {
+            free_chromosome(chromosome);
+        }
+    }
+}
+
+/*
+ * Function: free_island
+ * ---------------------
+ * Closes the sockets of the island and frees it. Island 0 also waits for
+ * all the other islands to exit.
+ */
+void free_island(Island *island) {
+    if (island) {
+        for (int i = 0; i < island->num_islands; ++i) {
+            close_socket(island->peers[i]);
+            close_socket(island->results[i]);
+        }
+        if (island->children) {
+            for (int i = 1; i < island->num_islands; ++i) {
+                int status;
+                if (waitpid(island->children[i], &status, 0) < 0 ||
+                    !WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+                    fprintf(stderr, "Island %d did not finish cleanly\n", i);
+                }
+            }
+        }
+        free(island->peers);
+        free(island->results);
+        free(island->children);
+        free(island);
+    }
+}
@@ -0,0 +1,321 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <assert.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "structures.h"
+#include "dataops.h"
+#include "managenn.h"
+#include "model.h"
+
+#define MODEL_MAGIC "GSNN"
+#define MODEL_VERSION 2
+#define MODEL_ALIGNMENT WEIGHTS_ALIGNMENT
+#define MODEL_MAX_NODES (1 << 20)
+
+/*
+ * The model is a native endian binary file laid out so that it can be
+ * mapped and used in place:
+ * 1. the header below, with the window the network takes its inputs from
+ * 2. the number of nodes of every layer, as uint32_t, from the input layer
+ *    to the output layer
+ * 3. for every layer after the input layer, its weights in the layout of
+ *    the network (see LAYER_WEIGHT), then its biases
+ * Each of 2. and the blocks of 3. starts on a multiple of MODEL_ALIGNMENT,
+ * the gaps being filled with zeros, so the weights of a mapped model are
+ * as aligned as those of a network allocated by mlp_create.
+ * Models of version 1 have no window in their header, which ends at
+ * window_days: they took whole days of DEFAULT_WINDOW_COLUMNS.
+ */
+typedef struct model_header {
+    char magic[4];
+    uint32_t version;
+    uint32_t real_size;
+    uint32_t num_layers;
+    double min;
+    double max;
+    uint32_t window_days;
+    uint32_t window_columns;
+    char columns[WINDOW_MAX_COLUMNS][WINDOW_COLUMN_NAME_SIZE];
+} ModelHeader;
+
+#define MODEL_V1_HEADER_SIZE offsetof(ModelHeader, window_days)
+
+static size_t align_offset(size_t offset) {
+    return (offset + MODEL_ALIGNMENT - 1) & ~(size_t)(MODEL_ALIGNMENT - 1);
+}
+
+static void write_block(FILE *file, const void *block, size_t size,
+                        size_t *offset) {
+    static const char zeros[MODEL_ALIGNMENT];
+    if (size && fwrite(block, size, 1, file) != 1) {
+        perror("Could not write the model");
+        exit(EXIT_FAILURE);
+    }
+    const size_t padding = align_offset(*offset + size) - (*offset + size);
+    if (padding && fwrite(zeros, padding, 1, file) != 1) {
+        perror("Could not write the model");
+        exit(EXIT_FAILURE);
+    }
+    *offset += size + padding;
+}
+
+/*
+ * Function: save_model
+ * --------------------
+ * Parameters:	c - chromosome that contains the mlp to be saved
+ *				name - the name of the file that will be saved to
+ *				targets - the targets of the nn required for min and max
+ *				no_targets - the number of targets required for min and max
+ *				window - the window the network takes its inputs from
+ *
+ * Same as save_nn, but the network is saved in the binary model format,
+ * which map_model loads without parsing or copying.
+ */
+void save_model(Chromosome *c, char name[], double **targets, int no_targets,
+                const Window *window) {
+    assert(c != NULL && name != NULL);
+    FILE *file = fopen(name, "wb");
+    if (file == NULL) {
+        perror("Could not open the file to save the model to");
+        exit(EXIT_FAILURE);
+    }
+
+    write_model(file, c->mlp, get_min(targets, no_targets, 0),
+                get_max(targets, no_targets, 0), window);
+    if (fclose(file)) {
+        perror("Could not write the model");
+        exit(EXIT_FAILURE);
+    }
+}
+
+/*
+ * Function: write_model
+ * ---------------------
+ * Parameters:	file - stream the model is written to, at the start of a file
+ *				mlp - the network to be saved
+ *				min, max - the minimum and maximum of the training targets
+ *				window - the window the network takes its inputs from
+ *
+ * Writes the network to the stream in the binary model format.
+ */
+void write_model(FILE *file, const MLP *mlp, double min, double max,
+                 const Window *window) {
+    assert(file != NULL && mlp != NULL && window != NULL);
+    assert(window_features(window) == mlp->input_layer->num_outputs);
+
+    ModelHeader header = {.version = MODEL_VERSION,
+                          .real_size = sizeof(mlp_real),
+                          .min = min,
+                          .max = max,
+                          .window_days = window->days,
+                          .window_columns = window->num_columns};
+    memcpy(header.magic, MODEL_MAGIC, 4);
+    memcpy(header.columns, window->columns, sizeof(header.columns));
+    for (const Layer *l = mlp->input_layer; l; l = l->next_layer) {
+        header.num_layers++;
+    }
+    uint32_t num_nodes[header.num_layers];
+    int k = 0;
+    for (const Layer *l = mlp->input_layer; l; l = l->next_layer) {
+        num_nodes[k++] = l->num_outputs;
+    }
+
+    size_t offset = 0;
+    if (fwrite(&header, sizeof(header), 1, file) != 1) {
+        perror("Could not write the model");
+        exit(EXIT_FAILURE);
+    }
+    offset += sizeof(header);
+    write_block(file, num_nodes, sizeof(num_nodes), &offset);
+
+    for (const Layer *l = mlp->input_layer->next_layer; l; l = l->next_layer) {
+        write_block(file, l->weights,
+                    (size_t)l->num_inputs * l->num_outputs * sizeof(mlp_real),
+                    &offset);
+        write_block(file, l->biases, l->num_outputs * sizeof(mlp_real),
+                    &offset);
+    }
+}
+
+/*
+ * Function: is_model_file
+ * -----------------------
+ * Returns true iff the file starts like a model in the binary format
+ */
+bool is_model_file(const char *filename) {
+    assert(filename != NULL);
+    FILE *file = fopen(filename, "rb");
+    if (file == NULL) {
+        return false;
+    }
+    char magic[4];
+    const bool model =
+        fread(magic, 4, 1, file) == 1 && !memcmp(magic, MODEL_MAGIC, 4);
+    fclose(file);
+    return model;
+}
+
+static void invalid_model(const char *filename, const char *reason) {
+    fprintf(stderr, "%s is not a valid model: %s\n", filename, reason);
+    exit(EXIT_FAILURE);
+}
+
+/*
+ * Function: read_window
+ * ---------------------
+ * Sets up the window saved in the header of a model, returns false if it
+ * is not a valid window
+ */
+static bool read_window(const ModelHeader *header, Window *window) {
+    if (header->window_columns == 0 ||
+        header->window_columns > WINDOW_MAX_COLUMNS ||
+        header->window_days > MODEL_MAX_NODES) {
+        return false;
+    }
+    char columns[WINDOW_MAX_COLUMNS * WINDOW_COLUMN_NAME_SIZE];
+    size_t length = 0;
+    for (uint32_t j = 0; j < header->window_columns; j++) {
+        const char *column = header->columns[j];
+        const char *end = memchr(column, '\0', WINDOW_COLUMN_NAME_SIZE);
+        if (end == NULL) {
+            return false;
+        }
+        memcpy(columns + length, column, end - column);
+        length += end - column;
+        columns[length++] = ',';
+    }
+    columns[length - 1] = '\0';
+    return parse_window(window, header->window_days, columns);
+}
+
+/*
+ * Function: map_model
+ * -------------------
+ * Parameters:	filename - a model written by save_model
+ *              min, max - pointers to hold the minimum and maximum of the
+ *                         training targets
+ *              window - pointer to hold the window the network takes its
+ *                       inputs from
+ *
+ * Maps the model into memory and returns a network whose biases and weights
+ * point straight into the mapping, so nothing is parsed or copied however
+ * big the network. The mapping is private: writing to the network (e.g. by
+ * training it further) never changes the file. mlp_free unmaps it.
+ */
+MLP *map_model(const char *filename, double *min, double *max,
+               Window *window) {
+    assert(filename != NULL && min != NULL && max != NULL && window != NULL);
+    const int fd = open(filename, O_RDONLY);
+    if (fd < 0) {
+        perror("Could not open the model");
+        exit(EXIT_FAILURE);
+    }
+    struct stat info;
+    if (fstat(fd, &info)) {
+        perror("Could not open the model");
+        exit(EXIT_FAILURE);
+    }
+    const size_t size = info.st_size;
+    if (size < MODEL_V1_HEADER_SIZE) {
+        invalid_model(filename, "too short");
+    }
+    void *mapping =
+        mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (mapping == MAP_FAILED) {
+        perror("Could not map the model");
+        exit(EXIT_FAILURE);
+    }
+
+    const ModelHeader *header = mapping;
+    if (memcmp(header->magic, MODEL_MAGIC, 4) ||
+        (header->version != MODEL_VERSION && header->version != 1)) {
+        invalid_model(filename, "unknown format");
+    }
+    const size_t header_size =
+        header->version == 1 ? MODEL_V1_HEADER_SIZE : sizeof(ModelHeader);
+    if (size < header_size) {
+        invalid_model(filename, "too short");
+    }
+    if (header->real_size != sizeof(mlp_real)) {
+        invalid_model(filename, "saved by a build of another precision");
+    }
+    const uint32_t num_layers = header->num_layers;
+    if (num_layers < 2 ||
+        num_layers > (size - header_size) / sizeof(uint32_t)) {
+        invalid_model(filename, "bad number of layers");
+    }
+
+    const uint32_t *nodes = (const uint32_t *)((char *)mapping + header_size);
+    int num_nodes[num_layers];
+    size_t offset =
+        align_offset(header_size + num_layers * sizeof(uint32_t));
+    for (uint32_t k = 0; k < num_layers; k++) {
+        if (nodes[k] == 0 || nodes[k] > MODEL_MAX_NODES) {
+            invalid_model(filename, "bad number of nodes");
+        }
+        num_nodes[k] = nodes[k];
+        if (k > 0) {
+            offset += align_offset((size_t)nodes[k - 1] * nodes[k] *
+                                   sizeof(mlp_real));
+            offset += align_offset(nodes[k] * sizeof(mlp_real));
+        }
+    }
+    if (offset != size) {
+        invalid_model(filename, "size does not match its layers");
+    }
+    const bool has_window = header->version == 1
+                                ? window_for_inputs(window, num_nodes[0])
+                                : read_window(header, window);
+    if (!has_window || window_features(window) != num_nodes[0]) {
+        invalid_model(filename, "bad window");
+    }
+
+    *min = header->min;
+    *max = header->max;
+    MLP *mlp = mlp_view(num_nodes, num_layers, mapping, size);
+
+    offset = align_offset(header_size + num_layers * sizeof(uint32_t));
+    for (Layer *l = mlp->input_layer->next_layer; l; l = l->next_layer) {
+        l->weights = (mlp_real *)((char *)mapping + offset);
+        offset += align_offset((size_t)l->num_inputs * l->num_outputs *
+                               sizeof(mlp_real));
+        l->biases = (mlp_real *)((char *)mapping + offset);
+        offset += align_offset(l->num_outputs * sizeof(mlp_real));
+    }
+    return mlp;
+}
+
+/*
+ * Function: load_model
+ * --------------------
+ * Parameters:	filename - a network saved by save_model or save_nn
+ *              min, max - pointers to hold the minimum and maximum of the
+ *                         training targets
+ *              window - pointer to hold the window the network takes its
+ *                       inputs from
+ *
+ * Loads a network in either format: binary models are mapped with
+ * map_model, anything else is parsed as CSV with load_net. A CSV has no
+ * room for the window, which is then taken to be whole days of
+ * DEFAULT_WINDOW_COLUMNS.
+ */
+MLP *load_model(const char *filename, double *min, double *max,
+                Window *window) {
+    assert(filename != NULL && window != NULL);
+    if (is_model_file(filename)) {
+        return map_model(filename, min, max, window);
+    }
+    MLP *mlp = load_net(filename, min, max);
+    if (!window_for_inputs(window, mlp->input_layer->num_outputs)) {
+        invalid_model(filename, "bad window");
+    }
+    return mlp;
+}
@@ -0,0 +1,88 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "structures.h"
+#include "createstructures.h"
+#include "mlp.h"
+#include "checkpoint.h"
+#include "testutils.h"
+
+#define POPULATION 4
+
+static bool same_chromosome(const Chromosome *c1, const Chromosome *c2) {
+    if (c1->fitness != c2->fitness || c1->learning_rate != c2->learning_rate ||
+        c1->hidden_layers != c2->hidden_layers ||
+        c1->nodes_per_layer != c2->nodes_per_layer ||
+        c1->inherited != c2->inherited) {
+        return false;
+    }
+    Layer *l1 = c1->mlp->input_layer->next_layer;
+    Layer *l2 = c2->mlp->input_layer->next_layer;
+    for (; l1 && l2; l1 = l1->next_layer, l2 = l2->next_layer) {
+        for (int i = 0; i < l1->num_inputs * l1->num_outputs; i++) {
+            if (l1->weights[i] != l2->weights[i]) {
+                return false;
+            }
+        }
+        for (int j = 0; j < l1->num_outputs; j++) {
+            if (l1->biases[j] != l2->biases[j]) {
+                return false;
+            }
+        }
+    }
+    return !l1 && !l2;
+}
+
+int main(void) {
+    GeneticState *state = create_genetic_state();
+    rng_seed(&state->rng, 99);
+    state->generation_number = 7;
+    state->mutation_probability = 0.25;
+    state->num_features = 12;
+    init_population(state, POPULATION);
+    for (int i = 0; i < POPULATION; i++) {
+        Chromosome *chromosome = state->current_generation->population[i];
+        chromosome->fitness = i * 1.5;
+        chromosome->inherited = i % 2;
+        chromosome->mlp->output_layer->biases[0] = 0.125 * i;
+    }
+    // the fittest individual is kept outside of the generation
+    state->fittest_individual = state->current_generation->population[0];
+    state->current_generation->population[0] = create_chromosome();
+    *state->current_generation->population[0] = *state->fittest_individual;
+    state->current_generation->population[0]->mlp =
+        mlp_clone(state->fittest_individual->mlp);
+
+    pid_t writer = save_checkpoint_background(state, "checkpoint.bin");
+    wait_checkpoint(writer);
+
+    GeneticState *loaded = load_checkpoint("checkpoint.bin");
+    testbool(rng_next(&state->rng) == rng_next(&loaded->rng) &&
+                 rng_next(&state->rng) == rng_next(&loaded->rng),
+             "The random number generator is restored");
+    testbool(loaded->generation_number == 7 &&
+                 loaded->mutation_probability == 0.25,
+             "The generation number and mutation probability are restored");
+    testbool(loaded->num_features == 12 &&
+                 loaded->current_generation->population[1]
+                         ->mlp->input_layer->num_outputs == 12,
+             "The number of inputs of the networks is restored");
+    bool same = loaded->current_generation->population_size == POPULATION;
+    for (int i = 0; same && i < POPULATION; i++) {
+        same = same_chromosome(state->current_generation->population[i],
+                               loaded->current_generation->population[i]);
+    }
+    testbool(same, "Every chromosome and network is restored");
+    testbool(loaded->fittest_individual &&
+                 same_chromosome(state->fittest_individual,
+                                 loaded->fittest_individual),
+             "The fittest individual is restored");
+
+    free_genetic_state(state);
+    free_genetic_state(loaded);
+    remove("checkpoint.bin");
+
+    return EXIT_SUCCESS;
+}
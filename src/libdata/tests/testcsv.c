@@ -0,0 +1,125 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "rng.h"
+#include "csv.h"
+#include "testutils.h"
+
+#define TEST_CSV "testcsv.csv"
+#define RANDOM_NUMBERS 100000
+#define BIG_ROWS 100000
+
+static bool same_double(double a, double b) {
+    return !memcmp(&a, &b, sizeof(double));
+}
+
+void test_parse_number(void) {
+    printf("Testing number parsing...\n");
+    const char *numbers[] = {
+        "0",     "-0",          "246.630569", "1e-5",   "-3.25E+2",  ".5",
+        "7.",    "0.000000001", "null",       "",       "1e400",     "nan",
+        "123456789012345678901234567890",     "9007199254740993",   "+42",
+        "2.2250738585072014e-308", "1.7976931348623157e308", "0x10"};
+    bool same = true;
+    for (size_t i = 0; i < sizeof(numbers) / sizeof(numbers[0]); i++) {
+        const char *n = numbers[i];
+        const double parsed = parse_csv_number(n, n + strlen(n));
+        const double expected = strtod(n, NULL);
+        same &= same_double(parsed, expected) ||
+                (parsed != parsed && expected != expected);
+    }
+    testbool(same, "Special numbers are parsed as strtod parses them");
+
+    Rng rng;
+    rng_seed(&rng, 21);
+    char buffer[64];
+    same = true;
+    for (int i = 0; i < RANDOM_NUMBERS; i++) {
+        const double value = (rng_double(&rng) - 0.5) * 2000;
+        const char *format = i % 3 == 0 ? "%f" : i % 3 == 1 ? "%.6g" : "%.17g";
+        const int length = snprintf(buffer, sizeof(buffer), format, value);
+        same &= same_double(parse_csv_number(buffer, buffer + length),
+                            strtod(buffer, NULL));
+    }
+    testbool(same, "Random numbers are parsed as strtod parses them");
+}
+
+void test_load_csv(void) {
+    printf("Testing CSV loading...\n");
+    FILE *file = fopen(TEST_CSV, "w");
+    fprintf(file, "Date,Open,Note,Close\r\n");
+    fprintf(file, "2010-06-03,1.5,short,2.5\r\n");
+    fprintf(file, "\r\n");
+    fprintf(file, "2010-06-04,-3,");
+    for (int i = 0; i < 1000; i++) {
+        fputc('x', file);
+    }
+    fprintf(file, ",4e2\n");
+    fprintf(file, "2010-06-05,null,,7");
+    fclose(file);
+
+    const char *columns[] = {"Close", "Open", "Close"};
+    CsvTable *table = load_csv(TEST_CSV, columns, 3, 1);
+    testbool(table->num_rows == 3 && table->num_columns == 3,
+             "Blank lines are skipped");
+    const double close[] = {2.5, 400, 7};
+    const double open[] = {1.5, -3, 0};
+    bool same = true;
+    for (int i = 0; i < 3; i++) {
+        same &= table->columns[0][i] == close[i];
+        same &= table->columns[1][i] == open[i];
+        same &= table->columns[2][i] == close[i];
+    }
+    testbool(same, "Columns are loaded in any order from long lines");
+    testbool(table->columns[1] == table->columns[0] + table->num_rows &&
+                 table->columns[2] == table->columns[1] + table->num_rows,
+             "Columns are contiguous");
+    free_csv(table);
+    remove(TEST_CSV);
+}
+
+void test_parallel_load(void) {
+    printf("Testing parallel CSV loading...\n");
+    FILE *file = fopen(TEST_CSV, "w");
+    fprintf(file, "Date,Open,High,Low,Close,Adj Close,Volume\n");
+    Rng rng;
+    rng_seed(&rng, 22);
+    for (int i = 0; i < BIG_ROWS; i++) {
+        if (i % 1000 == 0) {
+            fprintf(file, "\n");
+        }
+        fprintf(file, "2010-06-03");
+        for (int j = 0; j < 5; j++) {
+            fprintf(file, ",%f", rng_double(&rng) * 300);
+        }
+        fprintf(file, ",%d\n", i);
+    }
+    fclose(file);
+
+    const char *columns[] = {"Open", "High", "Low", "Close", "Volume"};
+    CsvTable *serial = load_csv(TEST_CSV, columns, 5, 1);
+    CsvTable *parallel = load_csv(TEST_CSV, columns, 5, 4);
+    testbool(serial->num_rows == BIG_ROWS && parallel->num_rows == BIG_ROWS,
+             "Every row is loaded by several workers");
+    testbool(!memcmp(serial->values, parallel->values,
+                     (size_t)BIG_ROWS * 5 * sizeof(double)),
+             "Several workers load the same table as one");
+    bool in_order = true;
+    for (int i = 0; i < BIG_ROWS; i++) {
+        in_order &= parallel->columns[4][i] == i;
+    }
+    testbool(in_order, "The rows of the chunks are kept in order");
+    free_csv(serial);
+    free_csv(parallel);
+    remove(TEST_CSV);
+}
+
+int main(void) {
+    test_parse_number();
+    test_load_csv();
+    test_parallel_load();
+    return EXIT_SUCCESS;
+}
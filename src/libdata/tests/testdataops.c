@@ -2,6 +2,7 @@
 #include <stdint.h>
 #include <stdlib.h>
 #include <float.h>
+#include <string.h>
 
 #include "testutils.h"
 #include "dataops.h"
@@ -65,8 +66,68 @@ void test_max() {
     free(test2);
 }
 
+void test_windows() {
+    double open[10], close[10];
+    for (int i = 0; i < 10; i++) {
+        open[i] = i;
+        close[i] = 100 + i;
+    }
+    double *columns[] = {open, close};
+    double *rows = interleave_columns(columns, 10, 2);
+    testbool(rows[6] == 3 && rows[7] == 103, "Columns are interleaved");
+
+    // overlapping windows of 3 days, each followed by its target
+    SampleView windows = window_view(rows, 10, 2, 3, 1);
+    SampleView targets = target_view(rows, 10, 2, 1, 3, 1);
+    testbool(windows.num_samples == 7 && targets.num_samples == 7,
+             "A window starts every day");
+    double **inputs = view_rows(windows);
+    double **outputs = view_rows(targets);
+    const double window[] = {2, 102, 3, 103, 4, 104};
+    bool same = true;
+    for (int i = 0; i < 6; i++) {
+        same &= inputs[2][i] == window[i];
+    }
+    testbool(same && outputs[2][0] == 105 && outputs[6][0] == 109,
+             "Windows and targets index the rows");
+    testbool(inputs[1] == rows + 2 && outputs[0] == rows + 7,
+             "Windows point into the rows without copies");
+    free(inputs);
+    free(outputs);
+
+    // disjoint windows, as with the batches of days + 1 rows of the first
+    // versions
+    windows = window_view(rows, 10, 2, 3, 4);
+    testbool(windows.num_samples == 2 && windows.stride == 8,
+             "Disjoint windows");
+
+    double min[2], max[2];
+    normalise_interleaved(rows, 10, 2, min, max);
+    testbool(min[1] == 100 && max[1] == 109 && rows[0] == 0 && rows[19] == 1,
+             "Interleaved rows are normalised column-wise");
+    free(rows);
+}
+
+void test_parse_window(void) {
+    Window window;
+    testbool(parse_window(&window, 3, "Open,Close,Volume") &&
+                 window.num_columns == 3 && window.target == 1 &&
+                 !strcmp(window.columns[2], "Volume") &&
+                 window_features(&window) == 9,
+             "Windows are parsed from a list of columns");
+    testbool(!parse_window(&window, 3, "Open,High") &&
+                 !parse_window(&window, 0, "Close") &&
+                 !parse_window(&window, 3, "Open,,Close"),
+             "Windows without a target, days or a column name are rejected");
+    testbool(window_for_inputs(&window, 20) && window.days == 5 &&
+                 window.num_columns == 4 && !window_for_inputs(&window, 18),
+             "Windows of networks saved without one are inferred");
+}
+
 int main(void) {
     test_min();
     test_max();
+    test_windows();
+    test_parse_window();
     return EXIT_SUCCESS;
 }
@@ -0,0 +1,90 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "csv.h"
+#include "dataset.h"
+#include "testutils.h"
+
+#define TEST_CSV "testdataset.csv"
+#define TEST_CACHE "testdataset.gsd"
+#define TEST_DATASET "converted.gsd"
+
+static void write_csv(double scale) {
+    FILE *file = fopen(TEST_CSV, "w");
+    fprintf(file, "Date,Open,High,Low,Close,Adj Close,Volume\n");
+    for (int i = 0; i < 100; i++) {
+        fprintf(file, "2010-06-03,%f,%f,%f,%f,%f,%d\n", i * scale,
+                i * scale + 1, i * scale - 1, i * scale + 0.5, i * scale, i);
+    }
+    fclose(file);
+}
+
+static bool same_table(const CsvTable *a, const CsvTable *b) {
+    bool same = a->num_rows == b->num_rows && a->num_columns == b->num_columns;
+    for (int j = 0; same && j < a->num_columns; j++) {
+        same = !memcmp(a->columns[j], b->columns[j],
+                       a->num_rows * sizeof(double));
+    }
+    return same;
+}
+
+void test_convert(void) {
+    printf("Testing dataset conversion...\n");
+    write_csv(1.5);
+    const char *columns[] = {"Open", "High", "Low", "Close"};
+    testbool(convert_csv(TEST_CSV, TEST_DATASET, columns, 4, 1),
+             "The CSV is converted");
+    testbool(is_dataset_file(TEST_DATASET) && !is_dataset_file(TEST_CSV),
+             "Datasets are told apart from CSV");
+
+    const char *reordered[] = {"Close", "Open"};
+    CsvTable *csv = load_csv(TEST_CSV, reordered, 2, 1);
+    CsvTable *dataset = map_dataset(TEST_DATASET, reordered, 2);
+    testbool(same_table(csv, dataset), "The dataset holds the CSV columns");
+    testbool(((uintptr_t)dataset->columns[0] % 64) == 0 &&
+                 ((uintptr_t)dataset->columns[1] % 64) == 0,
+             "The mapped columns are aligned");
+    free_csv(dataset);
+    free_csv(csv);
+    remove(TEST_DATASET);
+}
+
+void test_cache(void) {
+    printf("Testing the dataset cache...\n");
+    remove(TEST_CACHE);
+    write_csv(1.5);
+    const char *columns[] = {"Open", "High", "Low", "Close"};
+    CsvTable *parsed = load_dataset(TEST_CSV, columns, 4, 1);
+    testbool(parsed->mapping == NULL && access(TEST_CACHE, F_OK) == 0,
+             "The CSV is parsed and cached the first time");
+    CsvTable *cached = load_dataset(TEST_CSV, columns, 4, 1);
+    testbool(cached->mapping != NULL && same_table(parsed, cached),
+             "The cache is mapped the second time");
+    free_csv(cached);
+
+    write_csv(2.5);
+    CsvTable *changed = load_dataset(TEST_CSV, columns, 4, 1);
+    testbool(changed->mapping == NULL && changed->columns[0][99] == 99 * 2.5,
+             "A changed CSV is parsed again");
+    free_csv(changed);
+
+    const char *others[] = {"Volume"};
+    CsvTable *volume = load_dataset(TEST_CSV, others, 1, 1);
+    testbool(volume->mapping == NULL && volume->columns[0][99] == 99,
+             "Columns missing from the cache are parsed");
+    free_csv(volume);
+
+    free_csv(parsed);
+    remove(TEST_CACHE);
+    remove(TEST_CSV);
+}
+
+int main(void) {
+    test_convert();
+    test_cache();
+    return EXIT_SUCCESS;
+}
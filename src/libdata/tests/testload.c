@@ -2,12 +2,15 @@
 #include <stdio.h>
 #include <stdint.h>
 #include <stdbool.h>
+#include <string.h>
 
 #include "structures.h"
 #include "createstructures.h"
 #include "mlp.h"
 #include "dataops.h"
 #include "managenn.h"
+#include "model.h"
+#include "testutils.h"
 
 void test_load_save(void) {
     printf("Testing save and load...\n");
@@ -18,7 +21,9 @@ void test_load_save(void) {
         num_nodes[i] = 4;
     }
 
-    MLP *mlp_1 = mlp_initialise(num_nodes, num_layers);
+    Rng rng;
+    rng_seed(&rng, 1);
+    MLP *mlp_1 = mlp_initialise(num_nodes, num_layers, &rng);
     Chromosome *chr = create_chromosome();
     chr->mlp = mlp_1;
     chr->hidden_layers = 3;
@@ -46,7 +51,8 @@ void test_load_save(void) {
         //Test the weights for each layer
         for (k = 0; k < layer1->num_inputs; k++) {
             for (j = 0; j < layer1->num_outputs; j++) {
-                same = same ^ (layer1->weights[k][j] == layer2->weights[k][j]);
+                same = same ^ (LAYER_WEIGHT(layer1, k, j) ==
+                              LAYER_WEIGHT(layer2, k, j));
             }
         }
         //Test the biases for each layer
@@ -67,7 +73,93 @@ void test_load_save(void) {
     mlp_free(mlp_2);
 }
 
+static bool same_parameters(MLP *mlp1, MLP *mlp2) {
+    Layer *l1 = mlp1->input_layer->next_layer;
+    Layer *l2 = mlp2->input_layer->next_layer;
+    for (; l1 && l2; l1 = l1->next_layer, l2 = l2->next_layer) {
+        if (l1->num_inputs != l2->num_inputs ||
+            l1->num_outputs != l2->num_outputs) {
+            return false;
+        }
+        for (int i = 0; i < l1->num_inputs * l1->num_outputs; i++) {
+            if (l1->weights[i] != l2->weights[i]) {
+                return false;
+            }
+        }
+        for (int j = 0; j < l1->num_outputs; j++) {
+            if (l1->biases[j] != l2->biases[j]) {
+                return false;
+            }
+        }
+    }
+    return !l1 && !l2;
+}
+
+void test_model(void) {
+    printf("Testing binary models...\n");
+    Window window;
+    parse_window(&window, 3, "High,Close");
+    const int features = window_features(&window);
+    int num_nodes[] = {features, 7, 5, NO_OUTPUTS};
+    Rng rng;
+    rng_seed(&rng, 2);
+    Chromosome *chr = create_chromosome();
+    chr->mlp = mlp_initialise(num_nodes, 4, &rng);
+    chr->hidden_layers = 2;
+    chr->nodes_per_layer = 7;
+    for (Layer *l = chr->mlp->input_layer->next_layer; l; l = l->next_layer) {
+        for (int j = 0; j < l->num_outputs; j++) {
+            l->biases[j] = 0.25 * j - 0.5;
+        }
+    }
+
+    double tar1[] = {-1.5};
+    double tar2[] = {4.25};
+    double *targs[] = {tar1, tar2};
+    save_model(chr, "nn.bin", targs, 2, &window);
+
+    double min, max;
+    testbool(is_model_file("nn.bin") && !is_model_file("nn.csv"),
+             "Binary models are told apart from CSV");
+    Window loaded;
+    MLP *mapped = load_model("nn.bin", &min, &max, &loaded);
+    testbool(mapped->mapping != NULL, "The model is mapped");
+    testbool(min == -1.5 && max == 4.25, "Min and max are restored");
+    testbool(loaded.days == 3 && loaded.num_columns == 2 &&
+                 loaded.target == 1 && !strcmp(loaded.columns[0], "High") &&
+                 !strcmp(loaded.columns[1], "Close"),
+             "The window is restored");
+    testbool(same_parameters(chr->mlp, mapped),
+             "The weights and biases are restored exactly");
+    bool aligned = true;
+    for (Layer *l = mapped->input_layer->next_layer; l; l = l->next_layer) {
+        aligned = aligned && (uintptr_t)l->weights % WEIGHTS_ALIGNMENT == 0;
+    }
+    testbool(aligned, "The mapped weights are aligned");
+
+    double input[features];
+    for (int i = 0; i < features; i++) {
+        input[i] = 0.05 * i;
+    }
+    forward_prop(chr->mlp, input);
+    forward_prop(mapped, input);
+    testbool(chr->mlp->output_layer->outputs[0] ==
+                 mapped->output_layer->outputs[0],
+             "The mapped network predicts the same");
+
+    MLP *parsed = load_model("nn.csv", &min, &max, &loaded);
+    testbool(parsed->mapping == NULL, "CSV networks are still loaded");
+    testbool(loaded.days == 1 && loaded.num_columns == 4 && loaded.target == 3,
+             "CSV networks take whole days of the default columns");
+
+    mlp_free(parsed);
+    mlp_free(mapped);
+    free_chromosome(chr);
+    remove("nn.bin");
+}
+
 int main(void) {
     test_load_save();
+    test_model();
     return EXIT_SUCCESS;
 }
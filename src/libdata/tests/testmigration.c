@@ -0,0 +1,202 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/socket.h>
+
+#include "structures.h"
+#include "createstructures.h"
+#include "mlp.h"
+#include "migration.h"
+#include "testutils.h"
+
+#define POPULATION 6
+#define MIGRANTS 2
+#define FEATURES 4
+
+static bool same_chromosome(const Chromosome *c1, const Chromosome *c2) {
+    if (c1->learning_rate != c2->learning_rate ||
+        c1->hidden_layers != c2->hidden_layers ||
+        c1->nodes_per_layer != c2->nodes_per_layer ||
+        c1->epochs_trained != c2->epochs_trained) {
+        return false;
+    }
+    Layer *l1 = c1->mlp->input_layer->next_layer;
+    Layer *l2 = c2->mlp->input_layer->next_layer;
+    for (; l1 && l2; l1 = l1->next_layer, l2 = l2->next_layer) {
+        if (l1->num_inputs != l2->num_inputs ||
+            l1->num_outputs != l2->num_outputs) {
+            return false;
+        }
+        for (int i = 0; i < l1->num_inputs * l1->num_outputs; i++) {
+            if (l1->weights[i] != l2->weights[i]) {
+                return false;
+            }
+        }
+        for (int j = 0; j < l1->num_outputs; j++) {
+            if (l1->biases[j] != l2->biases[j]) {
+                return false;
+            }
+        }
+    }
+    return !l1 && !l2;
+}
+
+/*
+ * The fitness of a network is the bias of its output, so that the test
+ * knows which individuals migrate
+ */
+static double bias_fitness(MLP *mlp, double **targets, double **inputs,
+                           int no_inputs) {
+    (void)targets;
+    (void)inputs;
+    (void)no_inputs;
+    return mlp->output_layer->biases[0];
+}
+
+static GeneticState *island_state(uint64_t seed, double first_bias) {
+    GeneticState *state = create_genetic_state();
+    rng_seed(&state->rng, seed);
+    state->num_features = FEATURES;
+    state->workers = 1;
+    state->fitness_function = bias_fitness;
+    init_population(state, POPULATION);
+    for (int i = 0; i < POPULATION; i++) {
+        Chromosome *chromosome = state->current_generation->population[i];
+        chromosome->mlp->output_layer->biases[0] = first_bias + i;
+        chromosome->epochs_trained = 10 * (i + 1);
+    }
+    return state;
+}
+
+static Island *two_islands(int id, int peer) {
+    Island *island = calloc(1, sizeof(Island));
+    island->id = id;
+    island->num_islands = 2;
+    island->topology = TOPOLOGY_RING;
+    island->interval = 1;
+    island->migrants = MIGRANTS;
+    island->peers = malloc(2 * sizeof(int));
+    island->peers[id] = -1;
+    island->peers[1 - id] = peer;
+    island->results = malloc(2 * sizeof(int));
+    island->results[0] = island->results[1] = -1;
+    return island;
+}
+
+typedef struct migration_job {
+    Island *island;
+    GeneticState *state;
+} MigrationJob;
+
+static void *migrate_job(void *arg) {
+    MigrationJob *job = arg;
+    migrate(job->island, job->state, NULL, NULL, 0);
+    return NULL;
+}
+
+/*
+ * Returns true iff population holds an exact copy of chromosome
+ */
+static bool has_copy(Chromosome **population, const Chromosome *chromosome) {
+    for (int i = 0; i < POPULATION; i++) {
+        if (population[i] != chromosome &&
+            same_chromosome(population[i], chromosome)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void test_round_trip(void) {
+    GeneticState *state = island_state(1, 0);
+    Chromosome **population = state->current_generation->population;
+    for (int i = 0; i < POPULATION; i++) {
+        // values %lf would round to 6 decimals
+        population[i]->learning_rate = 0.1 + 1e-13 * i;
+        population[i]->mlp->output_layer->weights[0] = 1.0 / 3 + i;
+    }
+
+    size_t len;
+    char *message = serialise_chromosomes(population, POPULATION, &len);
+    Chromosome *received[POPULATION];
+    const int count = deserialise_chromosomes(message, len, received);
+    free(message);
+
+    bool same = count == POPULATION;
+    for (int i = 0; same && i < POPULATION; i++) {
+        same = same_chromosome(population[i], received[i]);
+    }
+    testbool(same, "Chromosomes are deserialised exactly as serialised");
+    for (int i = 0; i < count; i++) {
+        free_chromosome(received[i]);
+    }
+    free_genetic_state(state);
+}
+
+void test_migrate(void) {
+    int sockets[2];
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, sockets)) {
+        perror("socketpair");
+        exit(EXIT_FAILURE);
+    }
+    // island 1 is the fitter one, its best individuals replace the worst
+    // ones of island 0 and the other way round
+    GeneticState *states[2] = {island_state(2, 0), island_state(3, 100)};
+    Island *islands[2] = {two_islands(0, sockets[0]),
+                          two_islands(1, sockets[1])};
+    Chromosome *sent[2][MIGRANTS];
+    for (int k = 0; k < 2; k++) {
+        for (int m = 0; m < MIGRANTS; m++) {
+            // the fittest individuals are the last ones
+            const Chromosome *fittest = states[k]->current_generation
+                                            ->population[POPULATION - 1 - m];
+            sent[k][m] = create_chromosome();
+            *sent[k][m] = *fittest;
+            sent[k][m]->mlp = mlp_clone(fittest->mlp);
+        }
+    }
+
+    MigrationJob job = {.island = islands[1], .state = states[1]};
+    pthread_t thread;
+    pthread_create(&thread, NULL, migrate_job, &job);
+    migrate(islands[0], states[0], NULL, NULL, 0);
+    pthread_join(thread, NULL);
+
+    for (int k = 0; k < 2; k++) {
+        Chromosome **population = states[k]->current_generation->population;
+        bool arrived = true;
+        for (int m = 0; m < MIGRANTS; m++) {
+            arrived = arrived && has_copy(population, sent[1 - k][m]);
+        }
+        testbool(arrived, k == 0 ? "Island 0 receives the migrants of island 1"
+                                 : "Island 1 receives the migrants of island 0");
+
+        int worst = 0;
+        for (int i = 0; i < POPULATION; i++) {
+            const double bias = population[i]->mlp->output_layer->biases[0];
+            worst += bias == 100 * k || bias == 100 * k + 1;
+        }
+        testbool(worst == 0, k == 0 ? "The worst individuals of island 0 leave"
+                                    : "The worst individuals of island 1 leave");
+    }
+
+    for (int k = 0; k < 2; k++) {
+        for (int m = 0; m < MIGRANTS; m++) {
+            free_chromosome(sent[k][m]);
+        }
+        close(sockets[k]);
+        free(islands[k]->peers);
+        free(islands[k]->results);
+        free(islands[k]);
+        free_genetic_state(states[k]);
+    }
+}
+
+int main(void) {
+    test_round_trip();
+    test_migrate();
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,103 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <math.h>
+
+#include "structures.h"
+#include "mlp.h"
+#include "csv.h"
+#include "dataops.h"
+#include "geneticutils.h"
+#include "testutils.h"
+
+#define DATASET "../../misc_csv/data.csv"
+#define EPOCHS 30
+#define LEARNING_RATE 0.005
+#define RELATIVE_TOLERANCE 1e-3
+
+/*
+ * Function: reference_cost
+ * ------------------------
+ * Cost of the given network computed entirely in double precision straight
+ * from its weights, independently of the precision the library was built
+ * with.
+ */
+static double reference_cost(MLP *mlp, double **targets, double **inputs,
+                             int no_rows) {
+    double error = 0;
+    const int features = mlp->input_layer->num_outputs;
+    double values[2][NODES_PER_LAYER_UPPER + features];
+    for (int r = 0; r < no_rows; r++) {
+        double *in = values[0];
+        double *out = values[1];
+        for (int i = 0; i < features; i++) {
+            in[i] = inputs[r][i];
+        }
+        for (Layer *l = mlp->input_layer->next_layer; l; l = l->next_layer) {
+            for (int j = 0; j < l->num_outputs; j++) {
+                double sum = 0;
+                for (int i = 0; i < l->num_inputs; i++) {
+                    sum += (double)LAYER_WEIGHT(l, i, j) * in[i];
+                }
+                sum += l->biases[j];
+                if (l == mlp->output_layer) {
+                    out[j] = relu(sum);
+                } else {
+                    out[j] = sigmoid(sum);
+                }
+            }
+            double *swap = in;
+            in = out;
+            out = swap;
+        }
+        error += (targets[r][0] - in[0]) * (targets[r][0] - in[0]);
+    }
+    return error * 0.5 / no_rows;
+}
+
+void test_precision(void) {
+    Window window;
+    parse_window(&window, DEFAULT_WINDOW_DAYS, DEFAULT_WINDOW_COLUMNS);
+    const char *columns[WINDOW_MAX_COLUMNS];
+    window_column_names(&window, columns);
+    const int cols = window.num_columns;
+    CsvTable *data = load_csv(DATASET, columns, cols, 1);
+    const int no_rows = data->num_rows;
+    double *normalised = interleave_columns(data->columns, no_rows, cols);
+    normalise_interleaved(normalised, no_rows, cols, NULL, NULL);
+    // disjoint windows
+    const int days = window.days;
+    const int rows = count_windows(no_rows, days, days + 1);
+    double **inputs =
+        view_rows(window_view(normalised, no_rows, cols, days, days + 1));
+    double **outputs = view_rows(target_view(normalised, no_rows, cols,
+                                             window.target, days, days + 1));
+
+    const int validation_rows = rows / 5;
+    int layers[] = {window_features(&window), 16, 16, NO_OUTPUTS};
+    Rng rng;
+    rng_seed(&rng, 3);
+    MLP *mlp = mlp_initialise(layers, 4, &rng);
+    train_batch(mlp, inputs + validation_rows, rows - validation_rows,
+                outputs + validation_rows, LEARNING_RATE, EPOCHS, 1);
+
+    double result = cost(mlp, outputs, inputs, validation_rows);
+    double expected = reference_cost(mlp, outputs, inputs, validation_rows);
+    printf("Validation cost (%s precision network): %.9g\n",
+           sizeof(mlp_real) == sizeof(float) ? "single" : "double", result);
+    printf("Validation cost (double precision reference): %.9g\n", expected);
+    testbool(fabs(result - expected) <= RELATIVE_TOLERANCE * expected,
+             "Network cost matches the double precision reference");
+
+    mlp_free(mlp);
+    free_csv(data);
+    free(normalised);
+    free(inputs);
+    free(outputs);
+}
+
+int main(void) {
+    test_precision();
+    return EXIT_SUCCESS;
+}
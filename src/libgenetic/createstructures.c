@@ -3,6 +3,8 @@
 
 #include "structures.h"
 #include "geneticutils.h"
+#include "pool.h"
+#include "fitnesscache.h"
 
 /*
  * Function: create_chromosome
@@ -32,11 +34,13 @@ Generation *create_generation(void) {
  * Function: create_genetic_state
  * ------------------------------
  *  Returns a heap-allocated state for the genetic algorithm, initialised to
- *  0/NULL.
+ *  0/NULL, apart from its empty chromosome pool. Its random number stream
+ *  has to be seeded (see rng_seed) before the population is initialised.
  */
 GeneticState *create_genetic_state(void) {
     GeneticState *state = calloc(1, sizeof(GeneticState));
     assert(state);
+    state->pool = create_pool();
 
     return state;
 }
@@ -48,9 +52,12 @@ GeneticState *create_genetic_state(void) {
  *
  * state: the genetic state where the population should be attributed
  * population_size: size of the new population
+ *
+ * The genes are drawn from the state's random number stream, and the
+ * weights of each network from a stream of its own split off it.
  */
 void init_population(GeneticState *state, int population_size) {
-    assert(state);
+    assert(state && state->num_features > 0);
 
     state->current_generation = create_generation();
     Chromosome **new_population =
@@ -59,23 +66,25 @@ void init_population(GeneticState *state, int population_size) {
 
     for (int i = 0; i < population_size; ++i) {
         new_population[i] = create_chromosome();
-        new_population[i]->learning_rate =
-            double_rand_interval(LEARNING_RATE_LOWER, LEARNING_RATE_UPPER);
-        new_population[i]->hidden_layers =
-            int_rand_interval(HIDDEN_LAYERS_LOWER, HIDDEN_LAYERS_UPPER);
+        new_population[i]->learning_rate = double_rand_interval(
+            &state->rng, LEARNING_RATE_LOWER, LEARNING_RATE_UPPER);
+        new_population[i]->hidden_layers = int_rand_interval(
+            &state->rng, HIDDEN_LAYERS_LOWER, HIDDEN_LAYERS_UPPER);
 
-        new_population[i]->nodes_per_layer =
-            int_rand_interval(NODES_PER_LAYER_LOWER, NODES_PER_LAYER_UPPER);
+        new_population[i]->nodes_per_layer = int_rand_interval(
+            &state->rng, NODES_PER_LAYER_LOWER, NODES_PER_LAYER_UPPER);
 
         const int hidden_layers = new_population[i]->hidden_layers;
         int nodes[HIDDEN_LAYERS_UPPER + 2];
-        nodes[0] = NO_FEATURES;
+        nodes[0] = state->num_features;
         for (int j = 1; j <= hidden_layers; ++j) {
             nodes[j] = new_population[i]->nodes_per_layer;
         }
         nodes[hidden_layers + 1] = NO_OUTPUTS;
-        new_population[i]->mlp =
-            mlp_initialise(nodes, new_population[i]->hidden_layers + 2);
+        Rng weights;
+        rng_split(&weights, &state->rng);
+        new_population[i]->mlp = mlp_initialise(
+            nodes, new_population[i]->hidden_layers + 2, &weights);
     }
 
     state->current_generation->population_size = population_size;
@@ -97,14 +106,17 @@ void free_chromosome(Chromosome *chromosome) {
 /*
  * Function: free_generation
  * -------------------------
- *  Removes the given generation from the heap.
+ *  Removes the given generation from the heap. Its chromosomes, apart from
+ *  best_chromosome, are handed to the pool for reuse, or freed if the pool
+ *  is NULL.
  */
-void free_generation(Generation *generation, Chromosome *best_chromosome) {
+void free_generation(Generation *generation, Chromosome *best_chromosome,
+                     ChromosomePool *pool) {
     if (generation) {
         if (generation->population) {
             for (int i = 0; i < generation->population_size; ++i) {
                 if (generation->population[i] != best_chromosome) {
-                    free_chromosome(generation->population[i]);
+                    pool_release(pool, generation->population[i]);
                 }
             }
             free(generation->population);
@@ -121,8 +133,11 @@ void free_generation(Generation *generation, Chromosome *best_chromosome) {
  */
 void free_genetic_state(GeneticState *state) {
     if (state) {
-        free_generation(state->current_generation, state->fittest_individual);
+        free_generation(state->current_generation, state->fittest_individual,
+                        NULL);
         free_chromosome(state->fittest_individual);
+        free_pool(state->pool);
+        free_fitness_cache(state->cache);
         free(state);
     }
 }
@@ -8,7 +8,8 @@ extern void init_population(GeneticState *state, int population_size);
 
 extern void free_chromosome(Chromosome *chromosome);
 extern void free_generation(Generation *generation,
-                            Chromosome *best_chromosome);
+                            Chromosome *best_chromosome,
+                            ChromosomePool *pool);
 extern void free_genetic_state(GeneticState *state);
 
 #endif
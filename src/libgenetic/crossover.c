@@ -5,6 +5,7 @@
 #include "structures.h"
 #include "createstructures.h"
 #include "geneticutils.h"
+#include "pool.h"
 #include "mlp.h"
 
 /*
@@ -12,27 +13,29 @@
  * ----------------
  *  Parameter: chromosome - the chromosome to be mutated
  *  	mutation_probability - the chance (from 0 to 1) of the chromosome being
- *mutated. Returns: true iff the chromosome is mutated.
+ *mutated. rng - the random number stream the decisions are drawn from
+ *  Returns: true iff the chromosome is mutated.
  *
  *	The chromosome is mutated by assigning a random value between 0 and 1 to
  *the learning rate, and swapping two random positions in the number of nodes
  *per layer array.
  */
-bool mutate(Chromosome *chromosome, double mutation_probability) {
-    if (double_rand_interval(0, 1) < mutation_probability) {
+bool mutate(Chromosome *chromosome, double mutation_probability, Rng *rng) {
+    if (double_rand_interval(rng, 0, 1) < mutation_probability) {
         // assign random value (within normal range) to learning rate
         chromosome->learning_rate =
-            double_rand_interval(LEARNING_RATE_LOWER, LEARNING_RATE_UPPER);
+            double_rand_interval(rng, LEARNING_RATE_LOWER, LEARNING_RATE_UPPER);
 
         // flip a coin to determine whether to alter hidden layers or nodes per
         // layer
-        if (double_rand_interval(0, 1) < 0.5) {
+        if (double_rand_interval(rng, 0, 1) < 0.5) {
             // set random value to hidden_layers
             chromosome->hidden_layers =
-                int_rand_interval(HIDDEN_LAYERS_LOWER, HIDDEN_LAYERS_UPPER);
+                int_rand_interval(rng, HIDDEN_LAYERS_LOWER, HIDDEN_LAYERS_UPPER);
         } else {
             chromosome->nodes_per_layer =
-                int_rand_interval(NODES_PER_LAYER_LOWER, NODES_PER_LAYER_UPPER);
+                int_rand_interval(rng, NODES_PER_LAYER_LOWER,
+                                  NODES_PER_LAYER_UPPER);
         }
 
         return true;
@@ -41,51 +44,99 @@ bool mutate(Chromosome *chromosome, double mutation_probability) {
     return false;
 }
 
+/*
+ * Function: inheritance_parent
+ * ----------------------------
+ * Returns the parent the child should inherit its weights from, or NULL if
+ * neither parent's hidden layers are as wide as the child's.
+ */
+static Chromosome *inheritance_parent(const Chromosome *child,
+                                      Chromosome *parent1,
+                                      Chromosome *parent2) {
+    Chromosome *best = NULL;
+    int best_distance = 0;
+    Chromosome *parents[] = {parent1, parent2};
+    for (int i = 0; i < 2; ++i) {
+        Chromosome *parent = parents[i];
+        if (parent->nodes_per_layer != child->nodes_per_layer) {
+            continue;
+        }
+        const int distance = abs(parent->hidden_layers - child->hidden_layers);
+        if (!best || distance < best_distance ||
+            (distance == best_distance && parent->fitness > best->fitness)) {
+            best = parent;
+            best_distance = distance;
+        }
+    }
+    return best;
+}
+
 /*
  * Function: crossover
  * -------------------
  *  Parameter: parent1 - the first parent chromosome to be used in the crossover
  *  		parent2 - the second parent chromosome to be used in the
  * crossover mutation_probability - the chance of the child being mutation (from
- * 0 to 1) Returns: A child chromosome containing attributes from both parent
+ * 0 to 1) pool - retired chromosomes whose networks the child may reuse, or
+ * NULL inherit - whether the child starts from the trained weights of a
+ * parent rng - the random number stream of the algorithm's decisions
+ * Returns: A child chromosome containing attributes from both parent
  * chromosomes
  *
  *  The function uses uniform crossover for the learning rate and number of
  * hidden layers, but for the number of nodes per layer it then uses an
  * adaptation of the single point crossover (adapted to accommodate the fact
  * that the parents could have a different number of hidden layers).
+ *
+ * With inherit set, a child whose nodes per layer match those of a parent
+ * has that parent's trained weights copied into its network (see
+ * mlp_inherit) and is marked as inherited. Parents with exactly the child's
+ * topology are preferred, then the one with the closest number of hidden
+ * layers, then the fitter one.
+ *
+ * The weights of the child's network are drawn from a stream of its own,
+ * split off rng once the genes are decided.
  */
 Chromosome *crossover(Chromosome *parent1, Chromosome *parent2,
-                      double mutation_probability) {
+                      double mutation_probability, ChromosomePool *pool,
+                      bool inherit, Rng *rng) {
     assert(parent1 && parent2);  // checking the pointers aren't NULL
 
-    Chromosome *child = create_chromosome();
+    // the genes are decided first, the network to go with them is only
+    // taken from the pool once the topology is known
+    Chromosome genes = {0};
 
     // set learning rate
-    child->learning_rate = double_rand_interval(0, 1) < 0.5
-                               ? parent1->learning_rate
-                               : parent2->learning_rate;
+    genes.learning_rate = double_rand_interval(rng, 0, 1) < 0.5
+                              ? parent1->learning_rate
+                              : parent2->learning_rate;
 
     // set number of hidden layers
-    child->hidden_layers = double_rand_interval(0, 1) < 0.5
-                               ? parent1->hidden_layers
-                               : parent2->hidden_layers;
+    genes.hidden_layers = double_rand_interval(rng, 0, 1) < 0.5
+                              ? parent1->hidden_layers
+                              : parent2->hidden_layers;
 
     // set number of nodes per layer
-    child->nodes_per_layer = double_rand_interval(0, 1) < 0.5
-                                 ? parent1->nodes_per_layer
-                                 : parent2->nodes_per_layer;
+    genes.nodes_per_layer = double_rand_interval(rng, 0, 1) < 0.5
+                                ? parent1->nodes_per_layer
+                                : parent2->nodes_per_layer;
 
-    mutate(child, mutation_probability);
+    mutate(&genes, mutation_probability, rng);
 
-    const int hidden_layers = child->hidden_layers;
-    int nodes[HIDDEN_LAYERS_UPPER + 2];
-    nodes[0] = NO_FEATURES;
-    for (int j = 1; j <= hidden_layers; ++j) {
-        nodes[j] = child->nodes_per_layer;
-    }
-    nodes[hidden_layers + 1] = NO_OUTPUTS;
+    Rng weights;
+    rng_split(&weights, rng);
+    // the child takes the same inputs as its parents
+    Chromosome *child = pool_acquire(
+        pool, parent1->mlp->input_layer->num_outputs, genes.hidden_layers,
+        genes.nodes_per_layer, &weights);
+    child->learning_rate = genes.learning_rate;
 
-    child->mlp = mlp_initialise(nodes, hidden_layers + 2);
+    if (inherit) {
+        Chromosome *parent = inheritance_parent(child, parent1, parent2);
+        if (parent) {
+            mlp_inherit(child->mlp, parent->mlp);
+            child->inherited = true;
+        }
+    }
     return child;
 }
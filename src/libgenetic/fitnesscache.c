@@ -0,0 +1,212 @@
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+#include <assert.h>
+
+#include "structures.h"
+#include "fitnesscache.h"
+#include "mlp.h"
+
+#define INITIAL_BUCKETS 64
+
+/*
+ * Function: create_fitness_cache
+ * ------------------------------
+ *  Returns a heap-allocated, empty fitness cache.
+ *
+ *  learning_rate_quantum: learning rates rounding to the same multiple of this
+ *  share an entry, 0 for exact matches only
+ *  capacity: the most trained networks the cache keeps
+ */
+FitnessCache *create_fitness_cache(double learning_rate_quantum,
+                                   int capacity) {
+    assert(learning_rate_quantum >= 0);
+    assert(capacity >= 0);
+
+    FitnessCache *cache = calloc(1, sizeof(FitnessCache));
+    assert(cache);
+    cache->learning_rate_quantum = learning_rate_quantum;
+    cache->capacity = capacity;
+    cache->num_buckets = INITIAL_BUCKETS;
+    cache->buckets = calloc(cache->num_buckets, sizeof(FitnessCacheEntry *));
+    assert(cache->buckets);
+
+    return cache;
+}
+
+/*
+ * Function: cache_key
+ * -------------------
+ * Returns the key the given chromosome is cached under.
+ */
+static FitnessCacheKey cache_key(const FitnessCache *cache,
+                                 const Chromosome *chromosome) {
+    FitnessCacheKey key = {.hidden_layers = chromosome->hidden_layers,
+                           .nodes_per_layer = chromosome->nodes_per_layer};
+    if (cache->learning_rate_quantum > 0) {
+        key.learning_rate =
+            llround(chromosome->learning_rate / cache->learning_rate_quantum);
+    } else {
+        memcpy(&key.learning_rate, &chromosome->learning_rate,
+               sizeof(key.learning_rate));
+    }
+    return key;
+}
+
+/*
+ * Function: hash_key
+ * ------------------
+ * FNV-1a hash of the fields of a key.
+ */
+static uint64_t hash_key(const FitnessCacheKey *key) {
+    const uint64_t fields[] = {(uint64_t)key->learning_rate,
+                               (uint64_t)key->hidden_layers,
+                               (uint64_t)key->nodes_per_layer};
+    uint64_t hash = 14695981039346656037ULL;
+    for (size_t i = 0; i < sizeof(fields) / sizeof(fields[0]); ++i) {
+        for (int byte = 0; byte < 8; ++byte) {
+            hash ^= (fields[i] >> (8 * byte)) & 0xff;
+            hash *= 1099511628211ULL;
+        }
+    }
+    return hash;
+}
+
+static bool same_key(const FitnessCacheKey *k1, const FitnessCacheKey *k2) {
+    return k1->learning_rate == k2->learning_rate &&
+           k1->hidden_layers == k2->hidden_layers &&
+           k1->nodes_per_layer == k2->nodes_per_layer;
+}
+
+static FitnessCacheEntry *cache_find(const FitnessCache *cache,
+                                     const FitnessCacheKey *key) {
+    const uint64_t bucket = hash_key(key) & (cache->num_buckets - 1);
+    for (FitnessCacheEntry *entry = cache->buckets[bucket]; entry;
+         entry = entry->next) {
+        if (same_key(&entry->key, key)) {
+            return entry;
+        }
+    }
+    return NULL;
+}
+
+/*
+ * Function: cache_grow
+ * --------------------
+ * Doubles the number of buckets, rehashing every entry.
+ */
+static void cache_grow(FitnessCache *cache) {
+    const int num_buckets = 2 * cache->num_buckets;
+    FitnessCacheEntry **buckets =
+        calloc(num_buckets, sizeof(FitnessCacheEntry *));
+    assert(buckets);
+
+    for (int i = 0; i < cache->num_buckets; ++i) {
+        FitnessCacheEntry *entry = cache->buckets[i];
+        while (entry) {
+            FitnessCacheEntry *next = entry->next;
+            const uint64_t bucket = hash_key(&entry->key) & (num_buckets - 1);
+            entry->next = buckets[bucket];
+            buckets[bucket] = entry;
+            entry = next;
+        }
+    }
+    free(cache->buckets);
+    cache->buckets = buckets;
+    cache->num_buckets = num_buckets;
+}
+
+/*
+ * Function: fitness_cache_restore
+ * -------------------------------
+ * Looks every individual of the generation up in the cache. On a hit the
+ * cached weights are copied into the individual's network, its fitness is set
+ * and it is marked as cached, so that training and evaluation skip it.
+ * Resets the per generation hit counts.
+ *
+ * cache: the cache to look the individuals up in
+ * generation: the untrained generation
+ */
+void fitness_cache_restore(FitnessCache *cache, Generation *generation) {
+    assert(cache && generation);
+    cache->generation_lookups = 0;
+    cache->generation_hits = 0;
+
+    for (int i = 0; i < generation->population_size; ++i) {
+        Chromosome *chromosome = generation->population[i];
+        const FitnessCacheKey key = cache_key(cache, chromosome);
+        FitnessCacheEntry *entry = cache_find(cache, &key);
+
+        ++cache->generation_lookups;
+        if (entry) {
+            ++cache->generation_hits;
+            mlp_copy(chromosome->mlp, entry->mlp);
+            chromosome->fitness = entry->fitness;
+            chromosome->cached = true;
+        }
+    }
+    cache->lookups += cache->generation_lookups;
+    cache->hits += cache->generation_hits;
+}
+
+/*
+ * Function: fitness_cache_store
+ * -----------------------------
+ * Adds a copy of the network and the fitness of every fully trained and
+ * evaluated individual of the generation that is not in the cache yet, as
+ * long as there is room for it.
+ *
+ * cache: the cache to add the individuals to
+ * generation: the evaluated generation
+ */
+void fitness_cache_store(FitnessCache *cache, Generation *generation) {
+    assert(cache && generation);
+
+    for (int i = 0; i < generation->population_size; ++i) {
+        const Chromosome *chromosome = generation->population[i];
+        if (chromosome->cached || chromosome->dropped ||
+            cache->size >= cache->capacity) {
+            continue;
+        }
+        const FitnessCacheKey key = cache_key(cache, chromosome);
+        if (cache_find(cache, &key)) {
+            continue;
+        }
+
+        if (4 * (cache->size + 1) > 3 * cache->num_buckets) {
+            cache_grow(cache);
+        }
+        FitnessCacheEntry *entry = malloc(sizeof(FitnessCacheEntry));
+        assert(entry);
+        entry->key = key;
+        entry->fitness = chromosome->fitness;
+        entry->mlp = mlp_clone(chromosome->mlp);
+
+        const uint64_t bucket = hash_key(&key) & (cache->num_buckets - 1);
+        entry->next = cache->buckets[bucket];
+        cache->buckets[bucket] = entry;
+        ++cache->size;
+    }
+}
+
+/*
+ * Function: free_fitness_cache
+ * ----------------------------
+ *  Removes the given cache and all the networks in it from the heap
+ */
+void free_fitness_cache(FitnessCache *cache) {
+    if (cache) {
+        for (int i = 0; i < cache->num_buckets; ++i) {
+            FitnessCacheEntry *entry = cache->buckets[i];
+            while (entry) {
+                FitnessCacheEntry *next = entry->next;
+                mlp_free(entry->mlp);
+                free(entry);
+                entry = next;
+            }
+        }
+        free(cache->buckets);
+        free(cache);
+    }
+}
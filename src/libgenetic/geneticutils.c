@@ -1,23 +1,27 @@
 #include <stdlib.h>
 #include <assert.h>
 
+#include "rng.h"
+
 /*
  * Function: double_rand_interval
  * -------------------------------
- *  Generates and returns a random double between any interval
+ *  Generates and returns a random double between any interval, drawn from
+ *  the given random number stream
  */
-double double_rand_interval(double min, double max) {
-    double scale = (double)rand() / (double)RAND_MAX;
+double double_rand_interval(Rng *rng, double min, double max) {
+    double scale = rng_double(rng);
     return min + scale * (max - min);
 }
 
 /*
  * Function: int_rand_interval
  * ----------------------------
- *  Generates and returns a random int between any interval
+ *  Generates and returns a random int between any interval (both included),
+ *  drawn from the given random number stream
  */
-int int_rand_interval(int min, int max) {
-    return (rand() % (max - min + 1)) + min;
+int int_rand_interval(Rng *rng, int min, int max) {
+    return rng_int(rng, min, max);
 }
 
 /*
@@ -1,8 +1,10 @@
 #ifndef GENETIC_UTILS
 #define GENETIC_UTILS
 
-extern double double_rand_interval(double min, double max);
-extern int int_rand_interval(int min, int max);
+#include "rng.h"
+
+extern double double_rand_interval(Rng *rng, double min, double max);
+extern int int_rand_interval(Rng *rng, int min, int max);
 extern void free_pointer_matrix(void **matrix, int no_rows);
 
 #endif
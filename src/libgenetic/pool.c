@@ -0,0 +1,172 @@
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+#include "structures.h"
+#include "createstructures.h"
+#include "pool.h"
+#include "mlp.h"
+
+/*
+ * Function: pool_bucket
+ * ---------------------
+ * Returns the bucket holding the retired chromosomes of the given topology.
+ */
+static ChromosomeBucket *pool_bucket(ChromosomePool *pool, int hidden_layers,
+                                     int nodes_per_layer) {
+    assert(hidden_layers >= HIDDEN_LAYERS_LOWER &&
+           hidden_layers <= HIDDEN_LAYERS_UPPER);
+    assert(nodes_per_layer >= NODES_PER_LAYER_LOWER &&
+           nodes_per_layer <= NODES_PER_LAYER_UPPER);
+    return &pool->buckets[hidden_layers - HIDDEN_LAYERS_LOWER]
+                         [nodes_per_layer - NODES_PER_LAYER_LOWER];
+}
+
+/*
+ * Function: create_pool
+ * ---------------------
+ *  Returns a heap-allocated, empty chromosome pool keeping at most
+ *  POOL_DEFAULT_CAPACITY chromosomes
+ */
+ChromosomePool *create_pool(void) {
+    ChromosomePool *pool = calloc(1, sizeof(ChromosomePool));
+    assert(pool);
+    pool->capacity = POOL_DEFAULT_CAPACITY;
+
+    return pool;
+}
+
+/*
+ * Function: pool_evict
+ * --------------------
+ * Frees one chromosome of the bucket whose last release is the oldest, so
+ * that the networks of topologies the algorithm has moved away from do not
+ * stay in the pool for the whole run.
+ */
+static void pool_evict(ChromosomePool *pool) {
+    ChromosomeBucket *oldest = NULL;
+    const int layer_buckets = HIDDEN_LAYERS_UPPER - HIDDEN_LAYERS_LOWER + 1;
+    const int node_buckets = NODES_PER_LAYER_UPPER - NODES_PER_LAYER_LOWER + 1;
+    for (int i = 0; i < layer_buckets; ++i) {
+        for (int j = 0; j < node_buckets; ++j) {
+            ChromosomeBucket *bucket = &pool->buckets[i][j];
+            if (bucket->count > 0 &&
+                (!oldest || bucket->last_release < oldest->last_release)) {
+                oldest = bucket;
+            }
+        }
+    }
+    assert(oldest);
+    free_chromosome(oldest->chromosomes[--oldest->count]);
+    --pool->size;
+}
+
+/*
+ * Function: pool_acquire
+ * ----------------------
+ * Returns a chromosome with the given topology and a freshly randomised
+ * network, all other attributes of which are 0. A retired chromosome of the
+ * same topology is reused in place when the pool has one, otherwise a new one
+ * is allocated. The weights are drawn in the same order either way, so
+ * reusing storage does not change the course of the algorithm.
+ *
+ * pool: the pool to take the chromosome from, or NULL to always allocate
+ * num_inputs: the number of inputs of the network
+ * hidden_layers, nodes_per_layer: the topology of the network
+ * rng: the random number stream the weights are drawn from
+ */
+Chromosome *pool_acquire(ChromosomePool *pool, int num_inputs,
+                         int hidden_layers, int nodes_per_layer, Rng *rng) {
+    if (pool) {
+        ChromosomeBucket *bucket =
+            pool_bucket(pool, hidden_layers, nodes_per_layer);
+        if (bucket->count > 0) {
+            Chromosome *chromosome = bucket->chromosomes[--bucket->count];
+            --pool->size;
+            MLP *mlp = chromosome->mlp;
+            // every network of a run takes the same inputs
+            assert(mlp->input_layer->num_outputs == num_inputs);
+            memset(chromosome, 0, sizeof(Chromosome));
+            chromosome->hidden_layers = hidden_layers;
+            chromosome->nodes_per_layer = nodes_per_layer;
+            chromosome->mlp = mlp;
+            mlp_randomise(mlp, rng);
+            return chromosome;
+        }
+    }
+
+    Chromosome *chromosome = create_chromosome();
+    chromosome->hidden_layers = hidden_layers;
+    chromosome->nodes_per_layer = nodes_per_layer;
+
+    int nodes[HIDDEN_LAYERS_UPPER + 2];
+    nodes[0] = num_inputs;
+    for (int j = 1; j <= hidden_layers; ++j) {
+        nodes[j] = nodes_per_layer;
+    }
+    nodes[hidden_layers + 1] = NO_OUTPUTS;
+    chromosome->mlp = mlp_initialise(nodes, hidden_layers + 2, rng);
+
+    return chromosome;
+}
+
+/*
+ * Function: pool_release
+ * ----------------------
+ * Hands a chromosome that is no longer part of the algorithm back to the
+ * pool. Chromosomes without a network are simply freed, and so is a pool
+ * with no capacity. Once the pool is full, a chromosome of the topology
+ * released longest ago is freed to make room.
+ *
+ * pool: the pool to keep the chromosome in, or NULL to free it
+ * chromosome: the chromosome to retire, may be NULL
+ */
+void pool_release(ChromosomePool *pool, Chromosome *chromosome) {
+    if (!chromosome) {
+        return;
+    }
+    if (!pool || !chromosome->mlp || pool->capacity <= 0) {
+        free_chromosome(chromosome);
+        return;
+    }
+    while (pool->size >= pool->capacity) {
+        pool_evict(pool);
+    }
+
+    ChromosomeBucket *bucket = pool_bucket(pool, chromosome->hidden_layers,
+                                           chromosome->nodes_per_layer);
+    if (bucket->count == bucket->capacity) {
+        int capacity = bucket->capacity ? 2 * bucket->capacity : 4;
+        Chromosome **chromosomes =
+            realloc(bucket->chromosomes, capacity * sizeof(Chromosome *));
+        assert(chromosomes);
+        bucket->chromosomes = chromosomes;
+        bucket->capacity = capacity;
+    }
+    bucket->chromosomes[bucket->count++] = chromosome;
+    bucket->last_release = ++pool->releases;
+    ++pool->size;
+}
+
+/*
+ * Function: free_pool
+ * -------------------
+ *  Removes the given pool and every chromosome left in it from the heap
+ */
+void free_pool(ChromosomePool *pool) {
+    if (pool) {
+        const int layer_buckets = HIDDEN_LAYERS_UPPER - HIDDEN_LAYERS_LOWER + 1;
+        const int node_buckets =
+            NODES_PER_LAYER_UPPER - NODES_PER_LAYER_LOWER + 1;
+        for (int i = 0; i < layer_buckets; ++i) {
+            for (int j = 0; j < node_buckets; ++j) {
+                ChromosomeBucket *bucket = &pool->buckets[i][j];
+                for (int k = 0; k < bucket->count; ++k) {
+                    free_chromosome(bucket->chromosomes[k]);
+                }
+                free(bucket->chromosomes);
+            }
+        }
+        free(pool);
+    }
+}
@@ -0,0 +1,11 @@
+#ifndef CHROMOSOME_POOL
+#define CHROMOSOME_POOL
+
+extern ChromosomePool *create_pool(void);
+extern Chromosome *pool_acquire(ChromosomePool *pool, int num_inputs,
+                                int hidden_layers, int nodes_per_layer,
+                                Rng *rng);
+extern void pool_release(ChromosomePool *pool, Chromosome *chromosome);
+extern void free_pool(ChromosomePool *pool);
+
+#endif
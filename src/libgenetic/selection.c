@@ -2,11 +2,15 @@
 #include <assert.h>
 #include <stdlib.h>
 #include <stdio.h>
+#include <math.h>
 
 #include "mlp.h"
 #include "structures.h"
 #include "createstructures.h"
 #include "geneticutils.h"
+#include "parallel.h"
+#include "pool.h"
+#include "fitnesscache.h"
 #include "float.h"
 
 /*
@@ -28,6 +32,78 @@ double calculate_fitness(MLP *mlp, double **targets, double **inputs,
     return 1 / cost(mlp, targets, inputs, no_inputs);
 }
 
+/*
+ * typedef struct: fitness_job
+ * ---------------------------
+ * Everything a worker needs to evaluate one individual of a generation.
+ */
+typedef struct fitness_job {
+    double (*fitness_function)(MLP *, double **, double **, int);
+    Chromosome **population;
+    double **targets;
+    double **inputs;
+    int no_inputs;
+} FitnessJob;
+
+static void evaluate_job(int index, void *arg) {
+    FitnessJob *job = arg;
+    Chromosome *chromosome = job->population[index];
+    if (chromosome->cached) {
+        return;
+    }
+    chromosome->fitness = job->fitness_function(
+        chromosome->mlp, job->targets, job->inputs, job->no_inputs);
+}
+
+/*
+ * Function: evaluate_population
+ * -----------------------------
+ * Sets the fitness of the given individuals on up to state->workers threads,
+ * skipping those whose fitness came from the fitness cache.
+ *
+ * state: state holding the fitness function and number of workers
+ * population: the individuals to evaluate
+ * size: the number of individuals
+ */
+void evaluate_population(GeneticState *state, Chromosome **population,
+                         int size, double **targets, double **inputs,
+                         int no_inputs) {
+    assert(state);
+    FitnessJob job = {.fitness_function = state->fitness_function,
+                      .population = population,
+                      .targets = targets,
+                      .inputs = inputs,
+                      .no_inputs = no_inputs};
+    parallel_for(size, state->workers, NULL, evaluate_job, &job);
+}
+
+/*
+ * Function: compare_ranking
+ * -------------------------
+ * Orders chromosomes from the fittest down, with NaN fitness last.
+ */
+static int compare_ranking(const void *c1, const void *c2) {
+    const double f1 = (*(Chromosome *const *)c1)->fitness;
+    const double f2 = (*(Chromosome *const *)c2)->fitness;
+    if (isnan(f1) || isnan(f2)) {
+        return isnan(f1) - isnan(f2);
+    }
+    return (f1 < f2) - (f1 > f2);
+}
+
+/*
+ * Function: rank_population
+ * -------------------------
+ * Sorts the given individuals by fitness, the fittest first and those with
+ * a NaN fitness last.
+ *
+ * population: the individuals to sort
+ * size: the number of individuals
+ */
+void rank_population(Chromosome **population, int size) {
+    qsort(population, size, sizeof(Chromosome *), compare_ranking);
+}
+
 /*
  * Function: calculate_fittest
  * ---------------------------
@@ -36,20 +112,25 @@ double calculate_fitness(MLP *mlp, double **targets, double **inputs,
  * and the generation (while FREEING the old fittest_individual
  * if that's necessary).
  *
+ * The fitness of every individual is first evaluated on up to
+ * state->workers threads, each of them only writing to its own
+ * chromosome. The fittest is then picked in a separate serial pass,
+ * so ties always go to the first such individual in the population.
+ *
  * state: state to find the fittest chromosome for
  */
 void calculate_fittest(GeneticState *state, double **targets, double **inputs,
                        int no_inputs) {
     assert(state);
-    double (*fitness_function)(MLP *, double **, double **, int) =
-        state->fitness_function;
     Generation *generation = state->current_generation;
 
+    evaluate_population(state, generation->population,
+                        generation->population_size, targets, inputs,
+                        no_inputs);
+
     double max_fitness = -DBL_MAX;
 
     for (int i = 0; i < generation->population_size; ++i) {
-        generation->population[i]->fitness = fitness_function(
-            generation->population[i]->mlp, targets, inputs, no_inputs);
         if (generation->population[i]->fitness > max_fitness) {
             max_fitness = generation->population[i]->fitness;
             generation->fittest = generation->population[i];
@@ -60,9 +141,13 @@ void calculate_fittest(GeneticState *state, double **targets, double **inputs,
     state->fittest_individual_currently = generation->fittest;
     if (!state->fittest_individual ||
         generation->fittest->fitness > state->fittest_individual->fitness) {
-        free_chromosome(state->fittest_individual);
+        pool_release(state->pool, state->fittest_individual);
         state->fittest_individual = generation->fittest;
     }
+
+    if (state->cache) {
+        fitness_cache_store(state->cache, generation);
+    }
 }
 
 /*
@@ -128,7 +213,7 @@ Chromosome **get_parents(GeneticState *state, int number_of_pairs) {
 
     for (int i = 0; i < 2 * number_of_pairs; ++i) {
         int index;
-        double random_rank = double_rand_interval(0, 1);
+        double random_rank = double_rand_interval(&state->rng, 0, 1);
 
         for (index = 0; index < n && probabilities[index] < random_rank;
              ++index)
@@ -4,6 +4,12 @@
 extern double calculate_fitness(MLP *mlp, double **targets, double **inputs,
                                 int no_inputs);
 
+extern void evaluate_population(GeneticState *state, Chromosome **population,
+                                int size, double **targets, double **inputs,
+                                int no_inputs);
+
+extern void rank_population(Chromosome **population, int size);
+
 extern void calculate_fittest(GeneticState *state, double **targets,
                               double **inputs, int no_inputs);
 
@@ -14,9 +14,13 @@
 #define NODES_PER_LAYER_LOWER 5
 #define NODES_PER_LAYER_UPPER 60
 
-#define NO_FEATURES 20
 #define NO_OUTPUTS 1
 
+// the most retired chromosomes a pool keeps unless told otherwise
+#define POOL_DEFAULT_CAPACITY 64
+
+#include <stdbool.h>
+
 #include "mlp.h"
 
 /*
@@ -28,6 +32,16 @@
  * hidden_layers - the number of hidden layers in the mlp network. This
  * should be between 2 and 10 nodes_per_layer - number of nodes in each hidden
  * layer mlp_network - the mlp network for the individual
+ * cached - true if the network and fitness were taken from the fitness cache,
+ * so the individual needs neither training nor evaluation
+ * inherited - true if the network starts from the trained weights of a parent
+ * and so only needs the shorter warm start training
+ * epochs_trained - the number of epochs the network was trained for in its
+ * generation, which can be below the budget with early stopping
+ * dropped - true if successive halving stopped training the individual
+ * before its full number of epochs
+ * stopped - true if early stopping ended its training, so that later rungs
+ * of successive halving do not train it again
  */
 typedef struct chromosome {
     double fitness;
@@ -35,6 +49,11 @@ typedef struct chromosome {
     int hidden_layers;
     int nodes_per_layer;
     MLP *mlp;
+    bool cached;
+    bool inherited;
+    int epochs_trained;
+    bool dropped;
+    bool stopped;
 } Chromosome;
 
 /*
@@ -52,6 +71,97 @@ typedef struct generation {
     Chromosome **population;
 } Generation;
 
+/*
+ * typedef struct: chromosome_bucket
+ * ---------------------------------
+ * A stack of retired chromosomes that all share one network topology
+ * chromosomes - the retired chromosomes, networks included
+ * count - the number of chromosomes in the stack
+ * capacity - the number of chromosomes the stack has room for
+ * last_release - the release number (see chromosome_pool) of the last
+ * chromosome put in the stack
+ */
+typedef struct chromosome_bucket {
+    Chromosome **chromosomes;
+    int count;
+    int capacity;
+    long last_release;
+} ChromosomeBucket;
+
+/*
+ * typedef struct: chromosome_pool
+ * -------------------------------
+ * Retired chromosomes kept for reuse, with one bucket for every possible
+ * (hidden_layers, nodes_per_layer) pair, so that a child can take over the
+ * network of an individual with the same topology instead of allocating
+ * a new one.
+ * capacity - the most chromosomes kept in all the buckets together, the
+ * ones of the topologies released longest ago being freed first
+ * size - the number of chromosomes in all the buckets
+ * releases - the number of chromosomes released so far
+ */
+typedef struct chromosome_pool {
+    ChromosomeBucket buckets[HIDDEN_LAYERS_UPPER - HIDDEN_LAYERS_LOWER + 1]
+                            [NODES_PER_LAYER_UPPER - NODES_PER_LAYER_LOWER + 1];
+    int capacity;
+    int size;
+    long releases;
+} ChromosomePool;
+
+/*
+ * typedef struct: fitness_cache_key
+ * ---------------------------------
+ * The genome of an individual as seen by the fitness cache
+ * learning_rate - the learning rate, either rounded to a multiple of the
+ * cache's quantum or, with no quantum, its exact bit pattern
+ * hidden_layers, nodes_per_layer - the topology of the network
+ */
+typedef struct fitness_cache_key {
+    long long learning_rate;
+    int hidden_layers;
+    int nodes_per_layer;
+} FitnessCacheKey;
+
+/*
+ * typedef struct: fitness_cache_entry
+ * -----------------------------------
+ * A trained network together with its fitness, chained into a hash bucket
+ */
+typedef struct fitness_cache_entry {
+    FitnessCacheKey key;
+    double fitness;
+    MLP *mlp;
+    struct fitness_cache_entry *next;
+} FitnessCacheEntry;
+
+/*
+ * typedef struct: fitness_cache
+ * -----------------------------
+ * Trained networks and their fitness, keyed by genome, so that an individual
+ * identical to one trained before does not have to be trained again. The
+ * initial weights of every network are random draws anyway, so any trained
+ * network of a genome is taken to stand for all of them.
+ * learning_rate_quantum - learning rates which round to the same multiple of
+ * this share an entry, 0 to only match exact learning rates
+ * capacity - the most entries the cache holds, later networks are not kept
+ * size - the number of entries in the cache
+ * num_buckets - the number of hash buckets, a power of 2
+ * buckets - the hash buckets
+ * lookups, hits - totals over the whole run
+ * generation_lookups, generation_hits - totals for the current generation
+ */
+typedef struct fitness_cache {
+    double learning_rate_quantum;
+    int capacity;
+    int size;
+    int num_buckets;
+    FitnessCacheEntry **buckets;
+    long lookups;
+    long hits;
+    int generation_lookups;
+    int generation_hits;
+} FitnessCache;
+
 /*
  * typedef struct: genetic_algorithm_state
  * ---------------------------------------
@@ -66,6 +176,13 @@ typedef struct generation {
  * fitness_function - a function pointer to the function used
  * to calculate the fitness of individuals current_generation - the current
  * generation of mlp networks
+ * workers - the number of threads used to train and evaluate a generation
+ * num_features - the number of inputs of every network, set before the
+ * population is initialised
+ * pool - the retired chromosomes waiting to be reused by crossover
+ * cache - trained networks by genome, NULL if caching is turned off
+ * rng - the random number stream of the algorithm's decisions, the weights
+ * of every new network being drawn from a stream split off it
  */
 typedef struct genetic_algorithm_state {
     int generation_number;
@@ -74,6 +191,11 @@ typedef struct genetic_algorithm_state {
     Chromosome *fittest_individual_currently;
     double (*fitness_function)(MLP *, double **, double **, int);
     Generation *current_generation;
+    int workers;
+    int num_features;
+    ChromosomePool *pool;
+    FitnessCache *cache;
+    Rng rng;
 } GeneticState;
 
 #endif
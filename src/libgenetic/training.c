@@ -0,0 +1,232 @@
+#include <stdlib.h>
+#include <math.h>
+#include <assert.h>
+
+#include "structures.h"
+#include "parallel.h"
+#include "training.h"
+#include "fitnesscache.h"
+#include "selection.h"
+
+/*
+ * typedef struct: training_job
+ * ----------------------------
+ * Everything a worker needs to train one individual of a generation, budget
+ * being the fraction of its epochs it has to have been trained for.
+ */
+typedef struct training_job {
+    Chromosome **population;
+    double **inputs;
+    double **targets;
+    int no_inputs;
+    const TrainingOptions *options;
+    double budget;
+} TrainingJob;
+
+/*
+ * Function: training_cost
+ * -----------------------
+ * Rough cost of one epoch of training the network of the given chromosome,
+ * that is the number of weights it has.
+ */
+static long training_cost(const Chromosome *chromosome) {
+    const long nodes = chromosome->nodes_per_layer;
+    return chromosome->mlp->input_layer->num_outputs * nodes +
+           (chromosome->hidden_layers - 1) * nodes * nodes +
+           nodes * NO_OUTPUTS;
+}
+
+/*
+ * Function: training_epochs
+ * -------------------------
+ * Number of epochs the given chromosome is trained for.
+ */
+static int training_epochs(const Chromosome *chromosome,
+                           const TrainingOptions *options) {
+    return chromosome->inherited ? options->warm_start_epochs
+                                 : options->epochs;
+}
+
+/*
+ * typedef struct: scheduled_job
+ * -----------------------------
+ * Index of an individual in the population together with its training cost,
+ * used to start the most expensive networks first.
+ */
+typedef struct scheduled_job {
+    long cost;
+    int index;
+} ScheduledJob;
+
+static int compare_cost(const void *j1, const void *j2) {
+    const ScheduledJob *a = j1;
+    const ScheduledJob *b = j2;
+    if (a->cost != b->cost) {
+        return a->cost < b->cost ? 1 : -1;
+    }
+    return a->index - b->index;
+}
+
+/*
+ * Function: remaining_epochs
+ * --------------------------
+ * Number of epochs the given chromosome still has to be trained for to have
+ * had the given fraction of its epochs.
+ */
+static int remaining_epochs(const Chromosome *chromosome,
+                            const TrainingOptions *options, double budget) {
+    const int epochs = (int)ceil(training_epochs(chromosome, options) * budget);
+    return epochs - chromosome->epochs_trained;
+}
+
+static void train_job(int index, void *arg) {
+    TrainingJob *job = arg;
+    Chromosome *chromosome = job->population[index];
+    const TrainingOptions *options = job->options;
+    const int epochs = remaining_epochs(chromosome, options, job->budget);
+    if (options->early_stopping) {
+        const int trained = train_early_stopping(
+            chromosome->mlp, job->inputs, job->no_inputs, job->targets,
+            chromosome->learning_rate, epochs, options->batch_size,
+            options->early_stopping);
+        chromosome->epochs_trained += trained;
+        chromosome->stopped = trained < epochs;
+    } else {
+        train_batch(chromosome->mlp, job->inputs, job->no_inputs,
+                    job->targets, chromosome->learning_rate, epochs,
+                    options->batch_size);
+        chromosome->epochs_trained += epochs;
+    }
+}
+
+/*
+ * Function: train_population
+ * --------------------------
+ * Trains the given individuals on up to state->workers threads until each
+ * of them has had the given fraction of its epochs. The most expensive
+ * networks are started first and the rest are handed out dynamically, since
+ * a 10x60 network takes a lot longer than a 1x5 one. Individuals restored
+ * from the fitness cache, or whose training early stopping already ended,
+ * are left alone.
+ */
+static void train_population(GeneticState *state, Chromosome **population,
+                             int size, double **inputs, int no_inputs,
+                             double **targets, const TrainingOptions *options,
+                             double budget) {
+    ScheduledJob *schedule = malloc(size * sizeof(ScheduledJob));
+    int *order = malloc(size * sizeof(int));
+    assert(schedule && order);
+    int jobs = 0;
+    for (int i = 0; i < size; ++i) {
+        const Chromosome *chromosome = population[i];
+        const int epochs = remaining_epochs(chromosome, options, budget);
+        if (!chromosome->cached && !chromosome->stopped && epochs > 0) {
+            schedule[jobs].cost = training_cost(chromosome) * epochs;
+            schedule[jobs].index = i;
+            ++jobs;
+        }
+    }
+    qsort(schedule, jobs, sizeof(ScheduledJob), compare_cost);
+    for (int i = 0; i < jobs; ++i) {
+        order[i] = schedule[i].index;
+    }
+    free(schedule);
+
+    TrainingJob job = {.population = population,
+                       .inputs = inputs,
+                       .targets = targets,
+                       .no_inputs = no_inputs,
+                       .options = options,
+                       .budget = budget};
+    parallel_for(jobs, state->workers, order, train_job, &job);
+
+    free(order);
+}
+
+/*
+ * Function: successive_halving
+ * ----------------------------
+ * Trains the generation over halving->rungs rungs. On rung r of R every
+ * individual still in the running is trained until it has had
+ * keep_fraction^(R - 1 - r) of its epochs, so the last rung gives the full
+ * number. After every rung but the last, the individuals are ranked on the
+ * halving rows and all but the best keep_fraction of them are dropped,
+ * keeping the fitness of their partly trained network.
+ */
+static void successive_halving(GeneticState *state, double **inputs,
+                               int no_inputs, double **targets,
+                               const TrainingOptions *options) {
+    const SuccessiveHalving *halving = options->halving;
+    assert(halving->rungs > 0);
+    assert(halving->keep_fraction > 0 && halving->keep_fraction <= 1);
+    Generation *generation = state->current_generation;
+
+    int alive = generation->population_size;
+    Chromosome **ranking = malloc(alive * sizeof(Chromosome *));
+    assert(ranking);
+    for (int i = 0; i < alive; ++i) {
+        ranking[i] = generation->population[i];
+    }
+
+    for (int rung = 0; rung < halving->rungs; ++rung) {
+        const double budget =
+            pow(halving->keep_fraction, halving->rungs - 1 - rung);
+        train_population(state, ranking, alive, inputs, no_inputs, targets,
+                         options, budget);
+        if (rung == halving->rungs - 1) {
+            break;
+        }
+
+        evaluate_population(state, ranking, alive, halving->targets,
+                            halving->inputs, halving->num_rows);
+        rank_population(ranking, alive);
+        int kept = (int)ceil(alive * halving->keep_fraction);
+        if (kept < 1) {
+            kept = 1;
+        }
+        for (int i = kept; i < alive; ++i) {
+            ranking[i]->dropped = true;
+        }
+        alive = kept;
+    }
+
+    free(ranking);
+}
+
+/*
+ * Function: train_generation
+ * --------------------------
+ * Trains every individual of the current generation on up to
+ * state->workers threads. Training itself draws no random numbers, so the
+ * trained networks do not depend on the number of workers. With a fitness
+ * cache, individuals already trained in an earlier generation are restored
+ * from it instead. Individuals which inherited their weights are only
+ * trained for the warm start number of epochs. With early stopping the
+ * number of epochs is only an upper bound, each individual records how many
+ * it was trained for. With successive halving only the most promising
+ * individuals get all of their epochs, see successive_halving.
+ *
+ * state: genetic state whose current generation is trained
+ * inputs: training inputs
+ * no_inputs: number of training rows
+ * targets: training targets
+ * options: number of epochs and batch size used for every network
+ */
+void train_generation(GeneticState *state, double **inputs, int no_inputs,
+                      double **targets, const TrainingOptions *options) {
+    assert(state);
+    assert(options);
+    Generation *generation = state->current_generation;
+
+    if (state->cache) {
+        fitness_cache_restore(state->cache, generation);
+    }
+
+    if (options->halving) {
+        successive_halving(state, inputs, no_inputs, targets, options);
+    } else {
+        train_population(state, generation->population,
+                         generation->population_size, inputs, no_inputs,
+                         targets, options, 1);
+    }
+}
@@ -0,0 +1,48 @@
+#ifndef TRAINING_H
+#define TRAINING_H
+
+/*
+ * typedef struct: successive_halving
+ * ----------------------------------
+ * Multi-fidelity training of a generation: every individual is trained for
+ * a fraction of its epochs, ranked, and only the best keep_fraction of them
+ * are trained further, over several rungs
+ * rungs - the number of rounds of training, 1 trains everyone fully
+ * keep_fraction - the share of the individuals kept after each rung
+ * inputs, targets, num_rows - the rows the individuals are ranked on
+ */
+typedef struct successive_halving {
+    int rungs;
+    double keep_fraction;
+    double **inputs;
+    double **targets;
+    int num_rows;
+} SuccessiveHalving;
+
+/*
+ * typedef struct: training_options
+ * --------------------------------
+ * How the networks of a generation are trained
+ * epochs - the number of epochs every network is trained for
+ * batch_size - the number of samples per weight update, 1 for online
+ *              training
+ * warm_start_epochs - the number of epochs networks which inherited the
+ *                     weights of a parent are trained for
+ * early_stopping - when to stop training a network before its number of
+ *                  epochs is up, NULL to always train for all of them
+ * halving - how to spread the epochs over the generation, NULL to train
+ *           every individual for its full number of epochs
+ */
+typedef struct training_options {
+    int epochs;
+    int batch_size;
+    int warm_start_epochs;
+    const EarlyStopping *early_stopping;
+    const SuccessiveHalving *halving;
+} TrainingOptions;
+
+extern void train_generation(GeneticState *state, double **inputs,
+                             int no_inputs, double **targets,
+                             const TrainingOptions *options);
+
+#endif
@@ -0,0 +1,636 @@
+#include "kernels.h"
+
+#include <math.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define KERNELS_X86
+#include <immintrin.h>
+#endif
+
+/*
+ * The kernels are written once against mlp_real. The macros below map
+ * the scalar maths and the vector intrinsics onto the double or float
+ * versions depending on MLP_SINGLE_PRECISION.
+ */
+#ifdef MLP_SINGLE_PRECISION
+#define real_exp expf
+#else
+#define real_exp exp
+#endif
+
+/*
+ * Row kernels
+ * -----------
+ * ROW_TABLE generates the row kernels of a set (see MLPRowKernels): for
+ * every length of ROW_LENGTHS, wrappers calling the generic dot, dot4 and
+ * axpy of the set with the length as a constant, flattened so that the
+ * generic loops are compiled again for that trip count. The lengths cover
+ * the windows of a few days of open, high, low and close prices, which
+ * every network takes as inputs, and the narrower hidden layers. target is
+ * the target attribute of the set, empty for the scalar kernels.
+ */
+#ifdef __GNUC__
+#define KERNEL_FLATTEN __attribute__((flatten))
+#else
+#define KERNEL_FLATTEN
+#endif
+
+#define ROW_LENGTHS(X, set, target)                                      \
+    X(set, target, 8) X(set, target, 12) X(set, target, 16)             \
+    X(set, target, 20) X(set, target, 24) X(set, target, 28)            \
+    X(set, target, 32) X(set, target, 40)
+
+#define ROW_KERNELS(set, target, n)                                      \
+    target KERNEL_FLATTEN static mlp_real set##_dot_##n(                 \
+        const mlp_real *x, const mlp_real *y, int length) {              \
+        (void)length;                                                    \
+        return set##_dot(x, y, n);                                       \
+    }                                                                    \
+    target KERNEL_FLATTEN static void set##_dot4_##n(                    \
+        const mlp_real *w, const mlp_real *x0, const mlp_real *x1,       \
+        const mlp_real *x2, const mlp_real *x3, int length,              \
+        mlp_real *out) {                                                 \
+        (void)length;                                                    \
+        set##_dot4(w, x0, x1, x2, x3, n, out);                           \
+    }                                                                    \
+    target KERNEL_FLATTEN static void set##_axpy_##n(                    \
+        mlp_real a, const mlp_real *x, mlp_real *y, int length) {        \
+        (void)length;                                                    \
+        set##_axpy(a, x, y, n);                                          \
+    }
+
+#define ROW_ENTRY(set, target, n) \
+    {n, set##_dot_##n, set##_dot4_##n, set##_axpy_##n},
+
+#define ROW_TABLE(set, target)                                           \
+    ROW_LENGTHS(ROW_KERNELS, set, target)                                \
+    static const MLPRowKernels set##_rows[] = {                          \
+        ROW_LENGTHS(ROW_ENTRY, set, target){0, set##_dot, set##_dot4,    \
+                                            set##_axpy}}
+
+/*
+ * Scalar kernels
+ * --------------
+ * Portable fallback. They accumulate in exactly the same order as the
+ * original loops of mlp.c so results with them are reproducible bit for bit.
+ */
+static mlp_real scalar_dot(const mlp_real *x, const mlp_real *y, int n) {
+    mlp_real sum = 0;
+    for (int i = 0; i < n; i++) {
+        sum += x[i] * y[i];
+    }
+    return sum;
+}
+
+static void scalar_dot4(const mlp_real *w, const mlp_real *x0,
+                        const mlp_real *x1, const mlp_real *x2,
+                        const mlp_real *x3, int n, mlp_real *out) {
+    mlp_real sum0 = 0, sum1 = 0, sum2 = 0, sum3 = 0;
+    for (int i = 0; i < n; i++) {
+        sum0 += w[i] * x0[i];
+        sum1 += w[i] * x1[i];
+        sum2 += w[i] * x2[i];
+        sum3 += w[i] * x3[i];
+    }
+    out[0] = sum0;
+    out[1] = sum1;
+    out[2] = sum2;
+    out[3] = sum3;
+}
+
+static void scalar_axpy(mlp_real a, const mlp_real *x, mlp_real *y, int n) {
+    for (int i = 0; i < n; i++) {
+        y[i] += a * x[i];
+    }
+}
+
+/*
+ * The scalar activations are the precise ones, using libm's exp
+ */
+static void scalar_sigmoid(mlp_real *x, int n) {
+    for (int i = 0; i < n; i++) {
+        x[i] = 1 / (1 + real_exp(x[i] * -1));
+    }
+}
+
+static void scalar_relu(mlp_real *x, int n) {
+    const mlp_real leak = RELU_LEAK;
+    for (int i = 0; i < n; i++) {
+        x[i] = x[i] >= 0 ? x[i] : leak * x[i];
+    }
+}
+
+static void scalar_sigmoid_prime_mul(const mlp_real *outputs, mlp_real *delta,
+                                     int n) {
+    for (int i = 0; i < n; i++) {
+        delta[i] = outputs[i] * (1 - outputs[i]) * delta[i];
+    }
+}
+
+ROW_TABLE(scalar, );
+
+static const MLPKernels scalar_kernels = {
+    "scalar",    scalar_dot,     scalar_dot4,
+    scalar_axpy, scalar_sigmoid, scalar_relu,
+    scalar_sigmoid_prime_mul, scalar_rows};
+
+#ifdef KERNELS_X86
+
+/*
+ * Vector exp
+ * ----------
+ * x is clamped to [EXP_MIN, EXP_MAX] and split as n * ln(2) + r with
+ * |r| <= ln(2) / 2, exp(r) is then a Taylor polynomial of degree
+ * EXP_DEGREE, which keeps the relative error below 1e-14 for doubles and
+ * within a few ulps for floats, and 2^n is built directly in the exponent
+ * bits.
+ */
+#define LOG2E 1.4426950408889634
+#define LN2_HI 6.93145751953125e-1
+#define LN2_LO 1.42860682030941723212e-6
+
+static const double exp_coefficients[] = {
+    1.0 / 39916800, 1.0 / 3628800, 1.0 / 362880, 1.0 / 40320,
+    1.0 / 5040,     1.0 / 720,     1.0 / 120,    1.0 / 24,
+    1.0 / 6,        1.0 / 2,       1.0,          1.0};
+
+#ifdef MLP_SINGLE_PRECISION
+#define EXP_MAX 87.0
+#define EXP_MIN -87.0
+#define EXP_DEGREE 7
+#define V256 __m256
+#define V256_WIDTH 8
+#define v256_load _mm256_loadu_ps
+#define v256_store _mm256_storeu_ps
+#define v256_set1 _mm256_set1_ps
+#define v256_zero _mm256_setzero_ps
+#define v256_add _mm256_add_ps
+#define v256_sub _mm256_sub_ps
+#define v256_mul _mm256_mul_ps
+#define v256_div _mm256_div_ps
+#define v256_min _mm256_min_ps
+#define v256_max _mm256_max_ps
+#define v256_fmadd _mm256_fmadd_ps
+#define v256_fnmadd _mm256_fnmadd_ps
+#define v256_round _mm256_round_ps
+#define v256_cmp _mm256_cmp_ps
+#define v256_blendv _mm256_blendv_ps
+#define V512 __m512
+#define V512_WIDTH 16
+#define V512_MASK __mmask16
+#define v512_load _mm512_maskz_loadu_ps
+#define v512_store _mm512_mask_storeu_ps
+#define v512_set1 _mm512_set1_ps
+#define v512_zero _mm512_setzero_ps
+#define v512_add _mm512_add_ps
+#define v512_sub _mm512_sub_ps
+#define v512_mul _mm512_mul_ps
+#define v512_div _mm512_div_ps
+#define v512_min _mm512_min_ps
+#define v512_max _mm512_max_ps
+#define v512_fmadd _mm512_fmadd_ps
+#define v512_fnmadd _mm512_fnmadd_ps
+#define v512_roundscale _mm512_roundscale_ps
+#define v512_scalef _mm512_scalef_ps
+#define v512_reduce_add _mm512_reduce_add_ps
+#define v512_cmp_mask _mm512_cmp_ps_mask
+#define v512_mask_mul _mm512_mask_mul_ps
+#else
+#define EXP_MAX 708.0
+#define EXP_MIN -708.0
+#define EXP_DEGREE 11
+#define V256 __m256d
+#define V256_WIDTH 4
+#define v256_load _mm256_loadu_pd
+#define v256_store _mm256_storeu_pd
+#define v256_set1 _mm256_set1_pd
+#define v256_zero _mm256_setzero_pd
+#define v256_add _mm256_add_pd
+#define v256_sub _mm256_sub_pd
+#define v256_mul _mm256_mul_pd
+#define v256_div _mm256_div_pd
+#define v256_min _mm256_min_pd
+#define v256_max _mm256_max_pd
+#define v256_fmadd _mm256_fmadd_pd
+#define v256_fnmadd _mm256_fnmadd_pd
+#define v256_round _mm256_round_pd
+#define v256_cmp _mm256_cmp_pd
+#define v256_blendv _mm256_blendv_pd
+#define V512 __m512d
+#define V512_WIDTH 8
+#define V512_MASK __mmask8
+#define v512_load _mm512_maskz_loadu_pd
+#define v512_store _mm512_mask_storeu_pd
+#define v512_set1 _mm512_set1_pd
+#define v512_zero _mm512_setzero_pd
+#define v512_add _mm512_add_pd
+#define v512_sub _mm512_sub_pd
+#define v512_mul _mm512_mul_pd
+#define v512_div _mm512_div_pd
+#define v512_min _mm512_min_pd
+#define v512_max _mm512_max_pd
+#define v512_fmadd _mm512_fmadd_pd
+#define v512_fnmadd _mm512_fnmadd_pd
+#define v512_roundscale _mm512_roundscale_pd
+#define v512_scalef _mm512_scalef_pd
+#define v512_reduce_add _mm512_reduce_add_pd
+#define v512_cmp_mask _mm512_cmp_pd_mask
+#define v512_mask_mul _mm512_mask_mul_pd
+#endif
+
+#define EXP_FIRST_COEFFICIENT (11 - EXP_DEGREE)
+
+/*
+ * AVX2 kernels
+ * ------------
+ * V256_WIDTH values per vector with fused multiply-adds. The dot products
+ * keep two vector accumulators to hide the FMA latency.
+ */
+#ifdef MLP_SINGLE_PRECISION
+__attribute__((target("avx2,fma"))) static float avx2_hsum(__m256 v) {
+    __m128 low = _mm_add_ps(_mm256_castps256_ps128(v),
+                            _mm256_extractf128_ps(v, 1));
+    low = _mm_add_ps(low, _mm_movehl_ps(low, low));
+    low = _mm_add_ss(low, _mm_movehdup_ps(low));
+    return _mm_cvtss_f32(low);
+}
+
+/*
+ * Returns 2^n for vectors of whole numbers n
+ */
+__attribute__((target("avx2,fma"))) static __m256 avx2_pow2(__m256 n) {
+    __m256i exponent = _mm256_cvtps_epi32(n);
+    exponent = _mm256_slli_epi32(
+        _mm256_add_epi32(exponent, _mm256_set1_epi32(127)), 23);
+    return _mm256_castsi256_ps(exponent);
+}
+#else
+__attribute__((target("avx2,fma"))) static double avx2_hsum(__m256d v) {
+    __m128d low = _mm256_castpd256_pd128(v);
+    __m128d high = _mm256_extractf128_pd(v, 1);
+    low = _mm_add_pd(low, high);
+    high = _mm_unpackhi_pd(low, low);
+    return _mm_cvtsd_f64(_mm_add_sd(low, high));
+}
+
+/*
+ * Returns 2^n for vectors of whole numbers n
+ */
+__attribute__((target("avx2,fma"))) static __m256d avx2_pow2(__m256d n) {
+    __m256i exponent = _mm256_cvtepi32_epi64(_mm256_cvtpd_epi32(n));
+    exponent = _mm256_slli_epi64(
+        _mm256_add_epi64(exponent, _mm256_set1_epi64x(1023)), 52);
+    return _mm256_castsi256_pd(exponent);
+}
+#endif
+
+__attribute__((target("avx2,fma"))) static mlp_real avx2_dot(
+    const mlp_real *x, const mlp_real *y, int n) {
+    V256 acc0 = v256_zero();
+    V256 acc1 = v256_zero();
+    int i = 0;
+    for (; i + 2 * V256_WIDTH <= n; i += 2 * V256_WIDTH) {
+        acc0 = v256_fmadd(v256_load(x + i), v256_load(y + i), acc0);
+        acc1 = v256_fmadd(v256_load(x + i + V256_WIDTH),
+                          v256_load(y + i + V256_WIDTH), acc1);
+    }
+    for (; i + V256_WIDTH <= n; i += V256_WIDTH) {
+        acc0 = v256_fmadd(v256_load(x + i), v256_load(y + i), acc0);
+    }
+    mlp_real sum = avx2_hsum(v256_add(acc0, acc1));
+    for (; i < n; i++) {
+        sum += x[i] * y[i];
+    }
+    return sum;
+}
+
+__attribute__((target("avx2,fma"))) static void avx2_dot4(
+    const mlp_real *w, const mlp_real *x0, const mlp_real *x1,
+    const mlp_real *x2, const mlp_real *x3, int n, mlp_real *out) {
+    V256 acc0 = v256_zero();
+    V256 acc1 = v256_zero();
+    V256 acc2 = v256_zero();
+    V256 acc3 = v256_zero();
+    int i = 0;
+    for (; i + V256_WIDTH <= n; i += V256_WIDTH) {
+        V256 wv = v256_load(w + i);
+        acc0 = v256_fmadd(wv, v256_load(x0 + i), acc0);
+        acc1 = v256_fmadd(wv, v256_load(x1 + i), acc1);
+        acc2 = v256_fmadd(wv, v256_load(x2 + i), acc2);
+        acc3 = v256_fmadd(wv, v256_load(x3 + i), acc3);
+    }
+    mlp_real sum0 = avx2_hsum(acc0), sum1 = avx2_hsum(acc1);
+    mlp_real sum2 = avx2_hsum(acc2), sum3 = avx2_hsum(acc3);
+    for (; i < n; i++) {
+        sum0 += w[i] * x0[i];
+        sum1 += w[i] * x1[i];
+        sum2 += w[i] * x2[i];
+        sum3 += w[i] * x3[i];
+    }
+    out[0] = sum0;
+    out[1] = sum1;
+    out[2] = sum2;
+    out[3] = sum3;
+}
+
+__attribute__((target("avx2,fma"))) static void avx2_axpy(mlp_real a,
+                                                          const mlp_real *x,
+                                                          mlp_real *y, int n) {
+    V256 av = v256_set1(a);
+    int i = 0;
+    for (; i + V256_WIDTH <= n; i += V256_WIDTH) {
+        v256_store(y + i, v256_fmadd(av, v256_load(x + i), v256_load(y + i)));
+    }
+    for (; i < n; i++) {
+        y[i] += a * x[i];
+    }
+}
+
+__attribute__((target("avx2,fma"))) static V256 avx2_exp(V256 x) {
+    // min and max return their second operand when either is NaN, so NaN
+    // goes through the clamp and comes out of exp as NaN
+    x = v256_min(v256_set1(EXP_MAX), v256_max(v256_set1(EXP_MIN), x));
+    V256 n = v256_round(v256_mul(x, v256_set1(LOG2E)),
+                        _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+    V256 r = v256_fnmadd(n, v256_set1(LN2_HI), x);
+    r = v256_fnmadd(n, v256_set1(LN2_LO), r);
+
+    V256 p = v256_set1(exp_coefficients[EXP_FIRST_COEFFICIENT]);
+    for (int k = EXP_FIRST_COEFFICIENT + 1; k < 12; k++) {
+        p = v256_fmadd(p, r, v256_set1(exp_coefficients[k]));
+    }
+    return v256_mul(p, avx2_pow2(n));
+}
+
+__attribute__((target("avx2,fma"))) static void avx2_sigmoid(mlp_real *x,
+                                                             int n) {
+    const V256 one = v256_set1(1.0);
+    const V256 zero = v256_zero();
+    int i = 0;
+    for (; i + V256_WIDTH <= n; i += V256_WIDTH) {
+        V256 e = avx2_exp(v256_sub(zero, v256_load(x + i)));
+        v256_store(x + i, v256_div(one, v256_add(one, e)));
+    }
+    if (i < n) {
+        mlp_real tail[V256_WIDTH] = {0};
+        for (int k = 0; k < n - i; k++) {
+            tail[k] = x[i + k];
+        }
+        avx2_sigmoid(tail, V256_WIDTH);
+        for (int k = 0; k < n - i; k++) {
+            x[i + k] = tail[k];
+        }
+    }
+}
+
+__attribute__((target("avx2,fma"))) static void avx2_relu(mlp_real *x,
+                                                          int n) {
+    const V256 zero = v256_zero();
+    const V256 leak = v256_set1(RELU_LEAK);
+    int i = 0;
+    for (; i + V256_WIDTH <= n; i += V256_WIDTH) {
+        V256 v = v256_load(x + i);
+        // only the lanes below 0 are scaled, so NaN stays NaN
+        V256 negative = v256_cmp(v, zero, _CMP_LT_OQ);
+        v256_store(x + i, v256_blendv(v, v256_mul(leak, v), negative));
+    }
+    scalar_relu(x + i, n - i);
+}
+
+__attribute__((target("avx2,fma"))) static void avx2_sigmoid_prime_mul(
+    const mlp_real *outputs, mlp_real *delta, int n) {
+    const V256 one = v256_set1(1.0);
+    int i = 0;
+    for (; i + V256_WIDTH <= n; i += V256_WIDTH) {
+        V256 o = v256_load(outputs + i);
+        V256 prime = v256_mul(o, v256_sub(one, o));
+        v256_store(delta + i, v256_mul(prime, v256_load(delta + i)));
+    }
+    scalar_sigmoid_prime_mul(outputs + i, delta + i, n - i);
+}
+
+// the scalar tail of avx2_dot is never entered for the row lengths, which
+// gcc can not always tell once the other loops are unrolled
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Waggressive-loop-optimizations"
+ROW_TABLE(avx2, __attribute__((target("avx2,fma"))));
+#pragma GCC diagnostic pop
+
+static const MLPKernels avx2_kernels = {
+    "avx2",    avx2_dot,     avx2_dot4,
+    avx2_axpy, avx2_sigmoid, avx2_relu,
+    avx2_sigmoid_prime_mul, avx2_rows};
+
+/*
+ * AVX-512 kernels
+ * ---------------
+ * V512_WIDTH values per vector, the tails are handled with masked loads
+ * and stores instead of scalar loops.
+ */
+#define V512_TAIL(n, i)                                        \
+    ((n) - (i) >= V512_WIDTH ? (V512_MASK)((1u << V512_WIDTH) - 1) \
+                             : (V512_MASK)((1u << ((n) - (i))) - 1))
+
+__attribute__((target("avx512f"))) static mlp_real avx512_dot(
+    const mlp_real *x, const mlp_real *y, int n) {
+    V512 acc0 = v512_zero();
+    V512 acc1 = v512_zero();
+    const V512_MASK full = V512_TAIL(V512_WIDTH, 0);
+    int i = 0;
+    for (; i + 2 * V512_WIDTH <= n; i += 2 * V512_WIDTH) {
+        acc0 = v512_fmadd(v512_load(full, x + i), v512_load(full, y + i), acc0);
+        acc1 = v512_fmadd(v512_load(full, x + i + V512_WIDTH),
+                          v512_load(full, y + i + V512_WIDTH), acc1);
+    }
+    for (; i < n; i += V512_WIDTH) {
+        V512_MASK mask = V512_TAIL(n, i);
+        acc0 = v512_fmadd(v512_load(mask, x + i), v512_load(mask, y + i), acc0);
+    }
+    return v512_reduce_add(v512_add(acc0, acc1));
+}
+
+__attribute__((target("avx512f"))) static void avx512_dot4(
+    const mlp_real *w, const mlp_real *x0, const mlp_real *x1,
+    const mlp_real *x2, const mlp_real *x3, int n, mlp_real *out) {
+    V512 acc0 = v512_zero();
+    V512 acc1 = v512_zero();
+    V512 acc2 = v512_zero();
+    V512 acc3 = v512_zero();
+    for (int i = 0; i < n; i += V512_WIDTH) {
+        V512_MASK mask = V512_TAIL(n, i);
+        V512 wv = v512_load(mask, w + i);
+        acc0 = v512_fmadd(wv, v512_load(mask, x0 + i), acc0);
+        acc1 = v512_fmadd(wv, v512_load(mask, x1 + i), acc1);
+        acc2 = v512_fmadd(wv, v512_load(mask, x2 + i), acc2);
+        acc3 = v512_fmadd(wv, v512_load(mask, x3 + i), acc3);
+    }
+    out[0] = v512_reduce_add(acc0);
+    out[1] = v512_reduce_add(acc1);
+    out[2] = v512_reduce_add(acc2);
+    out[3] = v512_reduce_add(acc3);
+}
+
+__attribute__((target("avx512f"))) static void avx512_axpy(mlp_real a,
+                                                           const mlp_real *x,
+                                                           mlp_real *y,
+                                                           int n) {
+    V512 av = v512_set1(a);
+    for (int i = 0; i < n; i += V512_WIDTH) {
+        V512_MASK mask = V512_TAIL(n, i);
+        V512 yv = v512_load(mask, y + i);
+        yv = v512_fmadd(av, v512_load(mask, x + i), yv);
+        v512_store(y + i, mask, yv);
+    }
+}
+
+__attribute__((target("avx512f"))) static V512 avx512_exp(V512 x) {
+    // as in avx2_exp, NaN goes through the clamp
+    x = v512_min(v512_set1(EXP_MAX), v512_max(v512_set1(EXP_MIN), x));
+    V512 n = v512_roundscale(v512_mul(x, v512_set1(LOG2E)),
+                             _MM_FROUND_TO_NEAREST_INT);
+    V512 r = v512_fnmadd(n, v512_set1(LN2_HI), x);
+    r = v512_fnmadd(n, v512_set1(LN2_LO), r);
+
+    V512 p = v512_set1(exp_coefficients[EXP_FIRST_COEFFICIENT]);
+    for (int k = EXP_FIRST_COEFFICIENT + 1; k < 12; k++) {
+        p = v512_fmadd(p, r, v512_set1(exp_coefficients[k]));
+    }
+    return v512_scalef(p, n);
+}
+
+__attribute__((target("avx512f"))) static void avx512_sigmoid(mlp_real *x,
+                                                              int n) {
+    const V512 one = v512_set1(1.0);
+    const V512 zero = v512_zero();
+    for (int i = 0; i < n; i += V512_WIDTH) {
+        V512_MASK mask = V512_TAIL(n, i);
+        V512 e = avx512_exp(v512_sub(zero, v512_load(mask, x + i)));
+        v512_store(x + i, mask, v512_div(one, v512_add(one, e)));
+    }
+}
+
+__attribute__((target("avx512f"))) static void avx512_relu(mlp_real *x,
+                                                           int n) {
+    const V512 zero = v512_zero();
+    const V512 leak = v512_set1(RELU_LEAK);
+    for (int i = 0; i < n; i += V512_WIDTH) {
+        V512_MASK mask = V512_TAIL(n, i);
+        V512 v = v512_load(mask, x + i);
+        // only the lanes below 0 are scaled, so NaN stays NaN
+        V512_MASK negative = v512_cmp_mask(v, zero, _CMP_LT_OQ);
+        v512_store(x + i, mask, v512_mask_mul(v, negative, leak, v));
+    }
+}
+
+__attribute__((target("avx512f"))) static void avx512_sigmoid_prime_mul(
+    const mlp_real *outputs, mlp_real *delta, int n) {
+    const V512 one = v512_set1(1.0);
+    for (int i = 0; i < n; i += V512_WIDTH) {
+        V512_MASK mask = V512_TAIL(n, i);
+        V512 o = v512_load(mask, outputs + i);
+        V512 prime = v512_mul(o, v512_sub(one, o));
+        v512_store(delta + i, mask,
+                   v512_mul(prime, v512_load(mask, delta + i)));
+    }
+}
+
+ROW_TABLE(avx512, __attribute__((target("avx512f"))));
+
+static const MLPKernels avx512_kernels = {
+    "avx512",    avx512_dot,     avx512_dot4,
+    avx512_axpy, avx512_sigmoid, avx512_relu,
+    avx512_sigmoid_prime_mul, avx512_rows};
+
+#endif
+
+static MLPKernels selected_kernels;
+static pthread_once_t kernels_once = PTHREAD_ONCE_INIT;
+
+/*
+ * Function: mlp_supported_kernels
+ * -------------------------------
+ * Parameters:	kernels - array filled with the kernels this CPU can run
+ *				max - the size of the kernels array
+ *
+ * Returns the number of kernel sets supported by the CPU, fastest last.
+ * The scalar kernels are always supported.
+ */
+int mlp_supported_kernels(const MLPKernels **kernels, int max) {
+    int count = 0;
+    if (count < max) {
+        kernels[count++] = &scalar_kernels;
+    }
+#ifdef KERNELS_X86
+    __builtin_cpu_init();
+    if (count < max && __builtin_cpu_supports("avx2") &&
+        __builtin_cpu_supports("fma")) {
+        kernels[count++] = &avx2_kernels;
+    }
+    if (count < max && __builtin_cpu_supports("avx512f")) {
+        kernels[count++] = &avx512_kernels;
+    }
+#endif
+    return count;
+}
+
+/*
+ * Function: select_kernels
+ * ------------------------
+ * Picks the fastest kernels the CPU supports, unless the MLP_KERNELS
+ * environment variable names a supported set, e.g. MLP_KERNELS=scalar for
+ * bit-reproducible results. MLP_ACTIVATIONS=precise keeps the vector dense
+ * kernels but swaps the fast exp sigmoid for the libm one.
+ */
+static void select_kernels(void) {
+    const MLPKernels *supported[3];
+    int count = mlp_supported_kernels(supported, 3);
+    selected_kernels = *supported[count - 1];
+
+    const char *requested = getenv("MLP_KERNELS");
+    if (requested) {
+        for (int i = 0; i < count; i++) {
+            if (strcmp(requested, supported[i]->name) == 0) {
+                selected_kernels = *supported[i];
+            }
+        }
+    }
+
+    const char *activations = getenv("MLP_ACTIVATIONS");
+    if (activations && strcmp(activations, "precise") == 0) {
+        selected_kernels.sigmoid = scalar_sigmoid;
+    }
+}
+
+/*
+ * Function: mlp_kernels
+ * ---------------------
+ * Returns the kernels used by the network, chosen once at runtime
+ */
+const MLPKernels *mlp_kernels(void) {
+    pthread_once(&kernels_once, select_kernels);
+    return &selected_kernels;
+}
+
+/*
+ * Function: mlp_scalar_kernels
+ * ----------------------------
+ * Returns the portable scalar kernels
+ */
+const MLPKernels *mlp_scalar_kernels(void) { return &scalar_kernels; }
+
+/*
+ * Function: mlp_row_kernels
+ * -------------------------
+ * Returns the dense kernels of the set for rows of n values, specialised
+ * for n if it is one of the common row lengths, the generic ones otherwise
+ */
+const MLPRowKernels *mlp_row_kernels(const MLPKernels *kernels, int n) {
+    const MLPRowKernels *rows = kernels->rows;
+    while (rows->n != 0 && rows->n != n) {
+        rows++;
+    }
+    return rows;
+}
@@ -0,0 +1,66 @@
+#ifndef KERNELS_H
+#define KERNELS_H
+
+#include "mlp.h"
+
+typedef mlp_real (*mlp_dot_kernel)(const mlp_real *x, const mlp_real *y,
+                                   int n);
+typedef void (*mlp_dot4_kernel)(const mlp_real *w, const mlp_real *x0,
+                                const mlp_real *x1, const mlp_real *x2,
+                                const mlp_real *x3, int n, mlp_real *out);
+typedef void (*mlp_axpy_kernel)(mlp_real a, const mlp_real *x, mlp_real *y,
+                                int n);
+
+/*
+ * typedef struct: mlp_row_kernels
+ * -------------------------------
+ * The dense kernels of a set for rows of n values, compiled with n known
+ * so that their loops are fully unrolled. They give the same results as
+ * the generic kernels of the set, which take any n and come last with n 0.
+ */
+typedef struct mlp_row_kernels {
+    int n;
+    mlp_dot_kernel dot;
+    mlp_dot4_kernel dot4;
+    mlp_axpy_kernel axpy;
+} MLPRowKernels;
+
+/*
+ * typedef struct: mlp_kernels
+ * ---------------------------
+ * The dense loops the network spends its time in, in one flavour per
+ * instruction set, all working on mlp_real.
+ * name - the name of the instruction set, as accepted by MLP_KERNELS
+ * dot - returns the dot product of x and y
+ * dot4 - computes the dot products of w with x0, x1, x2 and x3 into out
+ * axpy - y += a * x
+ * sigmoid - applies the sigmoid function to every element of x in place
+ * relu - applies the leaky ReLU function to every element of x in place
+ * sigmoid_prime_mul - multiplies every delta by the sigmoid derivative at
+ *                     the matching output
+ * rows - dot, dot4 and axpy specialised for the common row lengths, see
+ *        mlp_row_kernels
+ */
+typedef struct mlp_kernels {
+    const char *name;
+    mlp_dot_kernel dot;
+    mlp_dot4_kernel dot4;
+    mlp_axpy_kernel axpy;
+    void (*sigmoid)(mlp_real *x, int n);
+    void (*relu)(mlp_real *x, int n);
+    void (*sigmoid_prime_mul)(const mlp_real *outputs, mlp_real *delta,
+                              int n);
+    const MLPRowKernels *rows;
+} MLPKernels;
+
+#define RELU_LEAK 0.05
+
+extern const MLPKernels *mlp_kernels(void);
+
+extern const MLPKernels *mlp_scalar_kernels(void);
+
+extern int mlp_supported_kernels(const MLPKernels **kernels, int max);
+
+extern const MLPRowKernels *mlp_row_kernels(const MLPKernels *kernels, int n);
+
+#endif
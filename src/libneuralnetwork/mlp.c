@@ -1,4 +1,7 @@
 #include "mlp.h"
+#include "kernels.h"
+#include "arena.h"
+#include "parallel.h"
 
 #include <math.h>
 #include <stdio.h>
@@ -6,9 +9,16 @@
 #include <stdbool.h>
 #include <assert.h>
 #include <string.h>
+#include <sys/mman.h>
 
 #define MEAN 0
 #define STD_DEV (4 / 3)
+#define WEIGHT_INIT_BLOCK 256
+
+// Number of samples whose dot products are computed together
+#define SAMPLE_BLOCK 4
+// the number of rows predict_batch hands to a worker at a time
+#define PREDICT_BLOCK 256
 
 /*
  * Function: activation functions
@@ -22,85 +32,92 @@ double sigmoid(double x) { return 1 / (1 + exp(x * -1)); }
 
 double sigmoid_prime(double x) { return x * (1 - x); }
 
-double relu(double x) { return x >= 0 ? x : 0.05 * x; }
+double relu(double x) { return x >= 0 ? x : RELU_LEAK * x; }
 
-double relu_prime(double x) { return x >= 0 ? 1 : 0.05; }
+double relu_prime(double x) { return x >= 0 ? 1 : RELU_LEAK; }
 
 /*
- * Function: random_deviation_num
- * --------------------
- * Parameters:	none
+ * Function: mlp_carve
+ * -------------------
+ * Parameters:	arena - arena the network is carved out of
+ *				num_nodes - the nodes in each layer of the MLP
+ *				num_layers - the number of layers in the whole MLP
+ *				parameters - whether the biases and weights are carved out
+ *							 too, or left NULL to be pointed elsewhere
  *
- * Utility function for getting random floats for weight init
- */
-double random_deviation_num() {
-    // Generate 2 random numbers between 0 and 1
-    double x1 = ((double)rand() + 1) / ((double)RAND_MAX + 1);
-    double x2 = ((double)rand() + 1) / ((double)RAND_MAX + 1);
-    // Transform randoms into a normally distributed random value
-    double normal_rand = sqrt(-2 * log(x1)) * cos(2 * M_PI * x2);
-    return normal_rand * STD_DEV + MEAN;
-}
-
-/*
- * Function: create_layer
- * ----------------------
- * Parameters: none
- * Creates a layer allocation on the heap
+ * Lays the network out in the arena: the MLP itself first, then the
+ * layers, then each layer's outputs, errors, biases and aligned weight
+ * block. With a measuring arena nothing is written and NULL is returned,
+ * the arena then holds the size the network needs.
  */
-Layer *create_layer(void) {
-    Layer *l = calloc(1, sizeof(Layer));
-    if (!l) {
-        perror("Memory allocation failed");
-        exit(EXIT_FAILURE);
+static MLP *mlp_carve(Arena *arena, const int *num_nodes, int num_layers,
+                      bool parameters) {
+    MLP *mlp = arena_alloc(arena, sizeof(MLP), ARENA_DEFAULT_ALIGNMENT);
+    Layer *layers = arena_alloc(arena, num_layers * sizeof(Layer),
+                                ARENA_DEFAULT_ALIGNMENT);
+
+    for (int k = 0; k < num_layers; k++) {
+        const size_t num_outputs = num_nodes[k];
+        mlp_real *outputs = arena_alloc(arena, num_outputs * sizeof(mlp_real),
+                                        ARENA_DEFAULT_ALIGNMENT);
+        mlp_real *biases = NULL, *errors = NULL, *weights = NULL;
+
+        // If it is the input layer than it has no weights or biases
+        if (k > 0) {
+            errors = arena_alloc(arena, num_outputs * sizeof(mlp_real),
+                                 ARENA_DEFAULT_ALIGNMENT);
+        }
+        if (k > 0 && parameters) {
+            biases = arena_alloc(arena, num_outputs * sizeof(mlp_real),
+                                 ARENA_DEFAULT_ALIGNMENT);
+            // All the weights of the layer live in one aligned block, one row
+            // of num_inputs weights per output node
+            weights = arena_alloc(
+                arena, num_outputs * num_nodes[k - 1] * sizeof(mlp_real),
+                WEIGHTS_ALIGNMENT);
+        }
+
+        if (mlp) {
+            Layer *layer = &layers[k];
+            layer->num_outputs = num_nodes[k];
+            layer->outputs = outputs;
+            layer->biases = biases;
+            layer->errors = errors;
+            layer->weights = weights;
+            if (k > 0) {
+                layer->num_inputs = num_nodes[k - 1];
+                layer->previous_layer = &layers[k - 1];
+                layers[k - 1].next_layer = layer;
+            }
+        }
+    }
+
+    if (mlp) {
+        mlp->input_layer = &layers[0];
+        mlp->output_layer = &layers[num_layers - 1];
     }
-    return l;
+    return mlp;
 }
 
 /*
- * Function: layer_initialise
- * --------------------------
- * Parameters:	layer - layer in question being initialised
- *				num_outputs - the number of outputs this layer will
- *have previous_layer - the previous layer to be linked
+ * Function: layer_randomise
+ * -------------------------
+ * Parameters:	layer - layer whose weights are drawn
+ *				rng - the random number stream the weights are drawn from
  *
- * Initialises a layer using the number of outputs, the previous layer and
- * the blank layer itself
+ * Draws every weight of the layer from the weight init distribution, in
+ * storage order and a block at a time
  */
-void layer_initialise(Layer *layer, int num_outputs, Layer *previous_layer) {
-    layer->num_outputs = num_outputs;
-    layer->outputs = calloc(num_outputs, sizeof(double));
-    if (!layer->outputs) {
-        perror("Memory allocation failure");
-        exit(EXIT_FAILURE);
-    }
-
-    // If it is the input layer than it has no weights or biases and so this
-    // must be checked first
-    if (previous_layer) {
-        layer->num_inputs = previous_layer->num_outputs;
-        layer->previous_layer = previous_layer;
-        previous_layer->next_layer = layer;
-        layer->biases = calloc(num_outputs, sizeof(double));
-        layer->errors = calloc(num_outputs, sizeof(double));
-        layer->weights = calloc(layer->num_inputs, sizeof(double *));
-
-        if (!layer->weights || !layer->errors || !layer->biases) {
-            perror("Memory allocation failure");
-            exit(EXIT_FAILURE);
-        }
-
-        int i;
-        for (i = 0; i < layer->num_inputs; i++) {
-            layer->weights[i] = malloc(num_outputs * sizeof(double));
-            if (!layer->weights[i]) {
-                perror("Memory allocation failure");
-                exit(EXIT_FAILURE);
-            }
-            int j;
-            for (j = 0; j < layer->num_outputs; j++) {
-                layer->weights[i][j] = random_deviation_num();
-            }
+static void layer_randomise(Layer *layer, Rng *rng) {
+    double block[WEIGHT_INIT_BLOCK];
+    const size_t size = (size_t)layer->num_inputs * layer->num_outputs;
+    for (size_t start = 0; start < size; start += WEIGHT_INIT_BLOCK) {
+        const int count = size - start < WEIGHT_INIT_BLOCK
+                              ? (int)(size - start)
+                              : WEIGHT_INIT_BLOCK;
+        rng_gaussian(rng, block, count, MEAN, STD_DEV);
+        for (int k = 0; k < count; k++) {
+            layer->weights[start + k] = block[k];
         }
     }
 }
@@ -121,6 +138,7 @@ void back_prop(MLP *mlp, double *target, double learning_rate) {
     assert(target != NULL);
     // We first have to work out the change in weights for each weight and
     // then we need to update the weights
+    const MLPKernels *kernels = mlp_kernels();
     Layer *output_l = mlp->output_layer;
 
     // Compute the errors for the output layer using ReLU prime
@@ -129,63 +147,92 @@ void back_prop(MLP *mlp, double *target, double learning_rate) {
                               (target[i] - output_l->outputs[i]);
     }
 
-    // Then compute the errors for each previous layer using sigmoid prime
+    // Then compute the errors for each previous layer using sigmoid prime.
+    // The weighted sums of the next layer's errors are accumulated one
+    // weight row at a time so that the weights are read contiguously
     Layer *current_l = output_l->previous_layer;
     while (current_l != mlp->input_layer) {
+        Layer *next_l = current_l->next_layer;
+        mlp_real *delta_sum = current_l->errors;
         for (int i = 0; i < current_l->num_outputs; i++) {
-            double delta_sum = 0;
-            for (int j = 0; j < current_l->next_layer->num_outputs; j++) {
-                delta_sum += current_l->next_layer->weights[i][j] *
-                             current_l->next_layer->errors[j];
-            }
-            current_l->errors[i] =
-                sigmoid_prime(current_l->outputs[i]) * delta_sum;
+            delta_sum[i] = 0;
+        }
+        const MLPRowKernels *rows =
+            mlp_row_kernels(kernels, current_l->num_outputs);
+        for (int j = 0; j < next_l->num_outputs; j++) {
+            const mlp_real *row = next_l->weights + (size_t)j * next_l->num_inputs;
+            rows->axpy(next_l->errors[j], row, delta_sum,
+                       current_l->num_outputs);
         }
+        kernels->sigmoid_prime_mul(current_l->outputs, delta_sum,
+                                   current_l->num_outputs);
         current_l = current_l->previous_layer;
     }
 
     // Then go back through the network and update the weights and biases
+    const mlp_real rate = learning_rate;
     current_l = output_l;
     while (current_l != mlp->input_layer) {
-        for (int i = 0; i < current_l->num_inputs; i++) {
-            for (int j = 0; j < current_l->num_outputs; j++) {
-                current_l->weights[i][j] +=
-                    learning_rate * current_l->errors[j] *
-                    current_l->previous_layer->outputs[i];
-            }
+        const mlp_real *inputs = current_l->previous_layer->outputs;
+        const MLPRowKernels *rows =
+            mlp_row_kernels(kernels, current_l->num_inputs);
+        for (int j = 0; j < current_l->num_outputs; j++) {
+            mlp_real *row = current_l->weights + (size_t)j * current_l->num_inputs;
+            const mlp_real scale = rate * current_l->errors[j];
+            rows->axpy(scale, inputs, row, current_l->num_inputs);
         }
 
         for (int i = 0; i < current_l->num_outputs; ++i) {
-            current_l->biases[i] += learning_rate * current_l->errors[i];
+            current_l->biases[i] += rate * current_l->errors[i];
         }
 
         current_l = current_l->previous_layer;
     }
 }
 
+/*
+ * Function: layer_forward
+ * -----------------------
+ * Parameters:	layer - layer whose weights and biases are used
+ *				inputs - the outputs of the previous layer
+ *				outputs - where the outputs of the layer are written
+ *				use_sigmoid - if the activation function will be sigmoid
+ *
+ * Feedforward for one layer between buffers given by the caller, the
+ * layer itself is only read.
+ */
+static void layer_forward(const Layer *layer, const mlp_real *inputs,
+                          mlp_real *outputs, bool use_sigmoid) {
+    const MLPKernels *kernels = mlp_kernels();
+    const MLPRowKernels *rows = mlp_row_kernels(kernels, layer->num_inputs);
+    int j;
+    for (j = 0; j < layer->num_outputs; j++) {
+        const mlp_real *row = layer->weights + (size_t)j * layer->num_inputs;
+        mlp_real sum = rows->dot(row, inputs, layer->num_inputs);
+        outputs[j] = layer->biases[j] + sum;
+    }
+
+    // Apply the activation function to the whole layer at once
+    if (use_sigmoid) {
+        kernels->sigmoid(outputs, layer->num_outputs);
+    } else {
+        kernels->relu(outputs, layer->num_outputs);
+    }
+}
+
 /*
  * Function: output_calc
  * ---------------------
  * Parameters:	layer - layer to be fedforward and calculate all the outputs
  *				use_sigmoid - if the activation function will be ReLU
  *or sigmoid Feedforward for one layer using either sigmoid or ReLU depending on
- *the layer
+ *the layer. The activation is applied to the whole layer by the vector
+ *kernels, see MLP_ACTIVATIONS for the precise sigmoid.
  */
 void output_calc(Layer *layer, bool use_sigmoid) {
     assert(layer != NULL);
-    int j;
-    for (j = 0; j < layer->num_outputs; j++) {
-        double sum = 0;
-        int i;
-        for (i = 0; i < layer->num_inputs; i++) {
-            sum += layer->weights[i][j] * layer->previous_layer->outputs[i];
-        }
-        if (use_sigmoid) {
-            layer->outputs[j] = sigmoid(layer->biases[j] + sum);
-        } else {
-            layer->outputs[j] = relu(layer->biases[j] + sum);
-        }
-    }
+    layer_forward(layer, layer->previous_layer->outputs, layer->outputs,
+                  use_sigmoid);
 }
 
 /*
@@ -211,6 +258,107 @@ void forward_prop(MLP *mlp, double *input_vals) {
     }
 }
 
+/*
+ * Function: context_carve
+ * -----------------------
+ * Lays an inference context for the network out in the arena: the context,
+ * its array of buffers, then an aligned buffer for the outputs of each
+ * layer. Like mlp_carve, a measuring arena only gives the size needed.
+ */
+static MLPContext *context_carve(Arena *arena, const MLP *mlp,
+                                 int num_layers) {
+    MLPContext *context =
+        arena_alloc(arena, sizeof(MLPContext), ARENA_DEFAULT_ALIGNMENT);
+    mlp_real **outputs = arena_alloc(arena, num_layers * sizeof(mlp_real *),
+                                     ARENA_DEFAULT_ALIGNMENT);
+    int k = 0;
+    for (const Layer *l = mlp->input_layer; l; l = l->next_layer, k++) {
+        mlp_real *layer_outputs = arena_alloc(
+            arena, l->num_outputs * sizeof(mlp_real), WEIGHTS_ALIGNMENT);
+        if (outputs) {
+            outputs[k] = layer_outputs;
+        }
+    }
+    if (context) {
+        context->num_layers = num_layers;
+        context->outputs = outputs;
+    }
+    return context;
+}
+
+/*
+ * Function: mlp_context_create
+ * ----------------------------
+ * Parameters:	mlp - the network the context is for
+ *
+ * Returns a heap-allocated inference context with room for the outputs of
+ * every layer of the network, allocated as a single block like the network
+ * itself. It can be used with any network of the same topology.
+ */
+MLPContext *mlp_context_create(const MLP *mlp) {
+    assert(mlp != NULL);
+    int num_layers = 0;
+    for (const Layer *l = mlp->input_layer; l; l = l->next_layer) {
+        num_layers++;
+    }
+
+    Arena arena;
+    arena_init(&arena, NULL, 0);
+    context_carve(&arena, mlp, num_layers);
+    const size_t size = arena.used;
+
+    void *block;
+    if (posix_memalign(&block, WEIGHTS_ALIGNMENT, size)) {
+        perror("Memory allocation fail");
+        exit(EXIT_FAILURE);
+    }
+    arena_init(&arena, block, size);
+    return context_carve(&arena, mlp, num_layers);
+}
+
+/*
+ * Function: mlp_context_free
+ * --------------------------
+ * Frees an inference context off of the heap
+ */
+void mlp_context_free(MLPContext *context) { free(context); }
+
+/*
+ * Function: mlp_forward
+ * ---------------------
+ * Parameters:	mlp - the network, which is only read
+ *				context - the calling thread's inference context, made for a
+ *						  network of the same topology
+ *				input_vals - the inputs to the first layer
+ *				output_vals - where the outputs of the last layer are
+ *							  written, may be NULL
+ *
+ * Same as forward_prop, but every activation is written to the context
+ * instead of the network, so any number of threads can run inference on
+ * one shared network at once, as long as each has its own context. The
+ * outputs are also left in the context's last buffer.
+ */
+void mlp_forward(const MLP *mlp, MLPContext *context, const double *input_vals,
+                 double *output_vals) {
+    assert(mlp != NULL && context != NULL);
+    assert(input_vals != NULL);
+    mlp_real **outputs = context->outputs;
+    for (int i = 0; i < mlp->input_layer->num_outputs; i++) {
+        outputs[0][i] = input_vals[i];
+    }
+    int k = 1;
+    for (const Layer *l = mlp->input_layer->next_layer; l;
+         l = l->next_layer, k++) {
+        assert(k < context->num_layers);
+        layer_forward(l, outputs[k - 1], outputs[k], l != mlp->output_layer);
+    }
+    if (output_vals) {
+        for (int j = 0; j < mlp->output_layer->num_outputs; j++) {
+            output_vals[j] = outputs[k - 1][j];
+        }
+    }
+}
+
 /*
  * Function: train
  * ---------------
@@ -243,6 +391,325 @@ void train(MLP *mlp, double **input_vals, int num_inputs, double **targets,
     }
 }
 
+/*
+ * typedef struct: batch_buffers
+ * -----------------------------
+ * Scratch space for training on a batch of samples at once.
+ * num_layers - number of layers of the network, including the input layer
+ * capacity - the maximum number of samples in a batch
+ * outputs - for each layer, capacity rows of the layer's outputs, one row
+ *           per sample stored contiguously
+ * errors - for each layer but the input one, the errors laid out the same
+ */
+typedef struct batch_buffers {
+    int num_layers;
+    int capacity;
+    mlp_real **outputs;
+    mlp_real **errors;
+} BatchBuffers;
+
+static BatchBuffers *batch_buffers_create(MLP *mlp, int capacity) {
+    BatchBuffers *buffers = calloc(1, sizeof(BatchBuffers));
+    if (!buffers) {
+        perror("Memory allocation failure");
+        exit(EXIT_FAILURE);
+    }
+
+    for (Layer *l = mlp->input_layer; l; l = l->next_layer) {
+        buffers->num_layers++;
+    }
+    buffers->capacity = capacity;
+    buffers->outputs = calloc(buffers->num_layers, sizeof(mlp_real *));
+    buffers->errors = calloc(buffers->num_layers, sizeof(mlp_real *));
+    if (!buffers->outputs || !buffers->errors) {
+        perror("Memory allocation failure");
+        exit(EXIT_FAILURE);
+    }
+
+    int k = 0;
+    for (Layer *l = mlp->input_layer; l; l = l->next_layer, k++) {
+        size_t size = (size_t)capacity * l->num_outputs * sizeof(mlp_real);
+        buffers->outputs[k] = malloc(size);
+        buffers->errors[k] = l == mlp->input_layer ? NULL : malloc(size);
+        if (!buffers->outputs[k] ||
+            (l != mlp->input_layer && !buffers->errors[k])) {
+            perror("Memory allocation failure");
+            exit(EXIT_FAILURE);
+        }
+    }
+    return buffers;
+}
+
+static void batch_buffers_free(BatchBuffers *buffers) {
+    for (int k = 0; k < buffers->num_layers; k++) {
+        free(buffers->outputs[k]);
+        free(buffers->errors[k]);
+    }
+    free(buffers->outputs);
+    free(buffers->errors);
+    free(buffers);
+}
+
+/*
+ * Function: batch_output_calc
+ * ---------------------------
+ * Parameters:	layer - layer whose outputs are computed
+ *				inputs - n rows of the previous layer's outputs
+ *				outputs - n rows to write this layer's outputs to
+ *				n - number of samples in the batch
+ *				use_sigmoid - if the activation function will be sigmoid
+ *
+ * Batched version of output_calc, computing the product of the batch with
+ * the weight matrix. Each weight row is reused for the whole batch and the
+ * dot products of SAMPLE_BLOCK samples are computed side by side. With the
+ * scalar kernels every sum is accumulated in the same order as in
+ * output_calc.
+ */
+static void batch_output_calc(const Layer *layer, const mlp_real *inputs,
+                              mlp_real *outputs, int n, bool use_sigmoid) {
+    const MLPKernels *kernels = mlp_kernels();
+    const int num_inputs = layer->num_inputs;
+    const int num_outputs = layer->num_outputs;
+    const MLPRowKernels *rows = mlp_row_kernels(kernels, num_inputs);
+    for (int j = 0; j < num_outputs; j++) {
+        const mlp_real *row = layer->weights + (size_t)j * num_inputs;
+        int b = 0;
+        for (; b + SAMPLE_BLOCK <= n; b += SAMPLE_BLOCK) {
+            const mlp_real *x0 = inputs + (size_t)b * num_inputs;
+            mlp_real sums[SAMPLE_BLOCK];
+            rows->dot4(row, x0, x0 + num_inputs, x0 + 2 * num_inputs,
+                       x0 + 3 * num_inputs, num_inputs, sums);
+            for (int s = 0; s < SAMPLE_BLOCK; s++) {
+                outputs[(size_t)(b + s) * num_outputs + j] = sums[s];
+            }
+        }
+        for (; b < n; b++) {
+            outputs[(size_t)b * num_outputs + j] = rows->dot(
+                row, inputs + (size_t)b * num_inputs, num_inputs);
+        }
+    }
+
+    for (int b = 0; b < n; b++) {
+        mlp_real *out = outputs + (size_t)b * num_outputs;
+        for (int j = 0; j < num_outputs; j++) {
+            out[j] = layer->biases[j] + out[j];
+        }
+    }
+
+    // Apply the activation function to the whole batch at once
+    if (use_sigmoid) {
+        kernels->sigmoid(outputs, n * num_outputs);
+    } else {
+        kernels->relu(outputs, n * num_outputs);
+    }
+}
+
+/*
+ * Function: batch_forward_prop
+ * ----------------------------
+ * Feedforward of the first n samples already copied into the input rows of
+ * the buffers, leaving every layer's outputs in the buffers
+ */
+static void batch_forward_prop(MLP *mlp, BatchBuffers *buffers, int n) {
+    int k = 1;
+    for (Layer *l = mlp->input_layer->next_layer; l; l = l->next_layer, k++) {
+        batch_output_calc(l, buffers->outputs[k - 1], buffers->outputs[k], n,
+                          l != mlp->output_layer);
+    }
+}
+
+/*
+ * Function: batch_back_prop
+ * -------------------------
+ * Backpropagation over a batch of n samples whose outputs were computed by
+ * batch_forward_prop. The errors of every layer are computed with the
+ * weights from before the batch, then the weights and biases are moved by
+ * learning_rate / n times the error of every sample. With n = 1 this does
+ * exactly the same floating point operations as back_prop.
+ */
+static void batch_back_prop(MLP *mlp, BatchBuffers *buffers, double **targets,
+                            int n, double learning_rate) {
+    const MLPKernels *kernels = mlp_kernels();
+    const int last = buffers->num_layers - 1;
+    Layer *output_l = mlp->output_layer;
+
+    // Compute the errors for the output layer using ReLU prime
+    for (int b = 0; b < n; b++) {
+        const mlp_real *out =
+            buffers->outputs[last] + (size_t)b * output_l->num_outputs;
+        mlp_real *err = buffers->errors[last] + (size_t)b * output_l->num_outputs;
+        for (int i = 0; i < output_l->num_outputs; i++) {
+            err[i] = relu_prime(out[i]) * (targets[b][i] - out[i]);
+        }
+    }
+
+    // Then compute the errors for each previous layer using sigmoid prime
+    int k = last - 1;
+    for (Layer *current_l = output_l->previous_layer;
+         current_l != mlp->input_layer;
+         current_l = current_l->previous_layer, k--) {
+        Layer *next_l = current_l->next_layer;
+        const int width = current_l->num_outputs;
+        const MLPRowKernels *rows = mlp_row_kernels(kernels, width);
+        for (int b = 0; b < n; b++) {
+            mlp_real *delta_sum = buffers->errors[k] + (size_t)b * width;
+            const mlp_real *next_err =
+                buffers->errors[k + 1] + (size_t)b * next_l->num_outputs;
+            for (int i = 0; i < width; i++) {
+                delta_sum[i] = 0;
+            }
+            for (int j = 0; j < next_l->num_outputs; j++) {
+                const mlp_real *row =
+                    next_l->weights + (size_t)j * next_l->num_inputs;
+                rows->axpy(next_err[j], row, delta_sum, width);
+            }
+            kernels->sigmoid_prime_mul(buffers->outputs[k] + (size_t)b * width,
+                                       delta_sum, width);
+        }
+    }
+
+    // Then go back through the network and update the weights and biases
+    const mlp_real step = learning_rate / n;
+    k = last;
+    for (Layer *current_l = output_l; current_l != mlp->input_layer;
+         current_l = current_l->previous_layer, k--) {
+        const int num_inputs = current_l->num_inputs;
+        const int num_outputs = current_l->num_outputs;
+        const MLPRowKernels *rows = mlp_row_kernels(kernels, num_inputs);
+        for (int j = 0; j < num_outputs; j++) {
+            mlp_real *row = current_l->weights + (size_t)j * num_inputs;
+            for (int b = 0; b < n; b++) {
+                const mlp_real *inputs =
+                    buffers->outputs[k - 1] + (size_t)b * num_inputs;
+                const mlp_real scale =
+                    step * buffers->errors[k][(size_t)b * num_outputs + j];
+                rows->axpy(scale, inputs, row, num_inputs);
+            }
+        }
+
+        for (int b = 0; b < n; b++) {
+            const mlp_real *err = buffers->errors[k] + (size_t)b * num_outputs;
+            for (int i = 0; i < num_outputs; ++i) {
+                current_l->biases[i] += step * err[i];
+            }
+        }
+    }
+}
+
+/*
+ * Function: train_batch
+ * ---------------------
+ * Parameters:	mlp - network being used for training
+ * input_vals - the entire dataset for training
+ * num_inputs - the number of inputs
+ * targets - the entire dataset for the target values
+ * learning_rate - hyperparameter for back propagation
+ * epochs - the number of training iterations
+ * batch_size - the number of samples per weight update
+ *
+ * Mini-batch training function
+ * Same as train but the samples are copied batch_size at a time into a
+ * contiguous buffer and fed forward and backward together, averaging the
+ * weight updates over the batch. A batch_size of 1 gives exactly the same
+ * network as train.
+ */
+void train_batch(MLP *mlp, double **input_vals, int num_inputs,
+                 double **targets, double learning_rate, int epochs,
+                 int batch_size) {
+    assert(mlp != NULL);
+    assert(input_vals != NULL);
+    assert(targets != NULL);
+    assert(batch_size > 0);
+    if (batch_size > num_inputs) {
+        batch_size = num_inputs > 0 ? num_inputs : 1;
+    }
+
+    BatchBuffers *buffers = batch_buffers_create(mlp, batch_size);
+    const int width = mlp->input_layer->num_outputs;
+    for (int e = 0; e < epochs; e++) {
+        for (int start = 0; start < num_inputs; start += batch_size) {
+            int n = num_inputs - start;
+            if (n > batch_size) {
+                n = batch_size;
+            }
+            for (int b = 0; b < n; b++) {
+                mlp_real *row = buffers->outputs[0] + (size_t)b * width;
+                for (int i = 0; i < width; i++) {
+                    row[i] = input_vals[start + b][i];
+                }
+            }
+            batch_forward_prop(mlp, buffers, n);
+            batch_back_prop(mlp, buffers, targets + start, n, learning_rate);
+        }
+    }
+    batch_buffers_free(buffers);
+}
+
+/*
+ * Function: train_early_stopping
+ * ------------------------------
+ * Parameters:	mlp - network being used for training
+ * input_vals - the entire dataset for training
+ * num_inputs - the number of inputs
+ * targets - the entire dataset for the target values
+ * learning_rate - hyperparameter for back propagation
+ * max_epochs - the most training iterations done
+ * batch_size - the number of samples per weight update
+ * stopping - the held-out set and when to stop
+ *
+ * Trains like train_batch, but every stopping->check_interval epochs the cost
+ * on the held-out set is computed. Training stops once it has not improved
+ * for stopping->patience checks in a row, or straight away if it is NaN or
+ * infinite, and the network is put back to the weights with the lowest
+ * held-out cost. Returns the number of epochs trained for.
+ */
+int train_early_stopping(MLP *mlp, double **input_vals, int num_inputs,
+                         double **targets, double learning_rate,
+                         int max_epochs, int batch_size,
+                         const EarlyStopping *stopping) {
+    assert(mlp != NULL);
+    assert(stopping != NULL);
+    assert(stopping->check_interval > 0);
+    assert(stopping->patience > 0);
+    assert(stopping->num_rows > 0);
+
+    MLP *best = NULL;
+    double best_cost = 0;
+    int checks_without_improvement = 0;
+    int epoch = 0;
+    while (epoch < max_epochs) {
+        int epochs = max_epochs - epoch;
+        if (epochs > stopping->check_interval) {
+            epochs = stopping->check_interval;
+        }
+        train_batch(mlp, input_vals, num_inputs, targets, learning_rate,
+                    epochs, batch_size);
+        epoch += epochs;
+
+        const double held_out_cost = cost(mlp, stopping->targets,
+                                          stopping->inputs, stopping->num_rows);
+        if (!isfinite(held_out_cost)) {
+            break;
+        }
+        if (!best) {
+            best = mlp_clone(mlp);
+            best_cost = held_out_cost;
+        } else if (held_out_cost < best_cost - stopping->min_delta) {
+            mlp_copy(best, mlp);
+            best_cost = held_out_cost;
+            checks_without_improvement = 0;
+        } else if (++checks_without_improvement >= stopping->patience) {
+            break;
+        }
+    }
+
+    if (best) {
+        mlp_copy(mlp, best);
+        mlp_free(best);
+    }
+    return epoch;
+}
+
 /*
  * Function: cost
  * --------------
@@ -270,23 +737,127 @@ double cost(MLP *mlp, double **targets, double **inputs, int no_rows) {
 }
 
 /*
- * Function: layer_free
- * --------------------
- * Parameters:	layer - the layer to be freed from the heap
+ * typedef struct: predict_job
+ * ---------------------------
+ * What the workers of predict_batch share
+ * mlp - the network making the predictions
+ * inputs, outputs - the whole input and output blocks
+ * stride - the number of values between the starts of consecutive rows of
+ *          inputs
+ * num_rows - the number of rows of the blocks
+ * width - the widest layer of the network
+ */
+typedef struct predict_job {
+    const MLP *mlp;
+    const double *inputs;
+    double *outputs;
+    int stride;
+    int num_rows;
+    int width;
+} PredictJob;
+
+/*
+ * Function: predict_rows
+ * ----------------------
+ * Predicts block number index of PREDICT_BLOCK rows, passing the block
+ * through the network a layer at a time in two scratch buffers of its own.
+ */
+static void predict_rows(int index, void *arg) {
+    const PredictJob *job = arg;
+    const MLP *mlp = job->mlp;
+    const int start = index * PREDICT_BLOCK;
+    const int n = job->num_rows - start < PREDICT_BLOCK ? job->num_rows - start
+                                                        : PREDICT_BLOCK;
+    const int num_inputs = mlp->input_layer->num_outputs;
+    const int num_outputs = mlp->output_layer->num_outputs;
+
+    mlp_real *scratch =
+        malloc(2 * (size_t)PREDICT_BLOCK * job->width * sizeof(mlp_real));
+    if (!scratch) {
+        perror("Memory allocation failure");
+        exit(EXIT_FAILURE);
+    }
+    mlp_real *in = scratch;
+    mlp_real *out = scratch + (size_t)PREDICT_BLOCK * job->width;
+
+    for (int r = 0; r < n; r++) {
+        const double *row = job->inputs + (size_t)(start + r) * job->stride;
+        for (int i = 0; i < num_inputs; i++) {
+            in[(size_t)r * num_inputs + i] = row[i];
+        }
+    }
+    for (const Layer *l = mlp->input_layer->next_layer; l; l = l->next_layer) {
+        batch_output_calc(l, in, out, n, l != mlp->output_layer);
+        mlp_real *swap = in;
+        in = out;
+        out = swap;
+    }
+
+    double *results = job->outputs + (size_t)start * num_outputs;
+    for (size_t i = 0; i < (size_t)n * num_outputs; i++) {
+        results[i] = in[i];
+    }
+    free(scratch);
+}
+
+/*
+ * Function: predict_batch
+ * -----------------------
+ * Parameters:	mlp - the network making the predictions
+ *				inputs - num_rows rows of the network's inputs, stored
+ *						 contiguously one row after the other
+ *				num_rows - the number of rows to predict
+ *				outputs - where the num_rows rows of the network's outputs
+ *						  are written, contiguously as well
+ *				workers - the number of threads to use
  *
- * Utility functions to free the layer off the heap
+ * Feedforward of a whole block of rows at once. The rows are split into
+ * blocks of PREDICT_BLOCK, each going through the network a layer at a time
+ * with the batched kernels, so every weight row is reused for the whole
+ * block. The network itself is not written to, so its outputs are left as
+ * they were.
  */
-void layer_free(Layer *layer) {
-    assert(layer != NULL);
-    int i;
-    for (i = 0; i < layer->num_inputs; i++) {
-        free(layer->weights[i]);
-    }
-    free(layer->weights);
-    free(layer->biases);
-    free(layer->errors);
-    free(layer->outputs);
-    free(layer);
+void predict_batch(const MLP *mlp, const double *inputs, int num_rows,
+                   double *outputs, int workers) {
+    assert(mlp != NULL);
+    predict_strided(mlp, inputs, mlp->input_layer->num_outputs, num_rows,
+                    outputs, workers);
+}
+
+/*
+ * Function: predict_strided
+ * -------------------------
+ * Parameters:	mlp - the network making the predictions
+ *				inputs - the first row of the network's inputs
+ *				stride - the number of values between the starts of
+ *						 consecutive rows, which overlap when it is less
+ *						 than the number of inputs (e.g. the windows of a
+ *						 SampleView)
+ *				num_rows - the number of rows to predict
+ *				outputs - where the num_rows rows of the network's outputs
+ *						  are written, contiguously
+ *				workers - the number of threads to use
+ *
+ * Same as predict_batch, for rows spaced stride values apart.
+ */
+void predict_strided(const MLP *mlp, const double *inputs, int stride,
+                     int num_rows, double *outputs, int workers) {
+    assert(mlp != NULL);
+    assert(num_rows >= 0 && stride >= 0);
+    assert((inputs != NULL && outputs != NULL) || num_rows == 0);
+
+    PredictJob job = {.mlp = mlp,
+                      .inputs = inputs,
+                      .outputs = outputs,
+                      .stride = stride,
+                      .num_rows = num_rows};
+    for (const Layer *l = mlp->input_layer; l; l = l->next_layer) {
+        if (l->num_outputs > job.width) {
+            job.width = l->num_outputs;
+        }
+    }
+    const int blocks = (num_rows + PREDICT_BLOCK - 1) / PREDICT_BLOCK;
+    parallel_for(blocks, workers, NULL, predict_rows, &job);
 }
 
 /*
@@ -294,47 +865,229 @@ void layer_free(Layer *layer) {
  * -----------------
  * Parameters:	mlp - the MLP to be freed
  *
- * Frees an MLP off of the heap
+ * Frees an MLP off of the heap. The whole network lives in the one block
+ * starting at the MLP itself, apart from the parameters of a network made
+ * by mlp_view, whose mapping is unmapped.
  */
 
 void mlp_free(MLP *mlp) {
-    Layer *curr = mlp->input_layer;
-    Layer *next;
-    while (curr) {
-        next = curr->next_layer;
-        layer_free(curr);
-        curr = next;
+    if (mlp && mlp->mapping) {
+        munmap(mlp->mapping, mlp->mapping_size);
     }
     free(mlp);
 }
 
+/*
+ * Function: mlp_allocate
+ * ----------------------
+ * Sizes a network with the given layers, allocates it as a single zeroed
+ * block and lays it out, leaving all of its weights at 0. Without
+ * parameters the biases and weights are left out of the block.
+ */
+static MLP *mlp_allocate(const int *num_nodes, int num_layers,
+                         bool parameters) {
+    Arena arena;
+    arena_init(&arena, NULL, 0);
+    mlp_carve(&arena, num_nodes, num_layers, parameters);
+    const size_t size = arena.used;
+
+    void *block;
+    if (posix_memalign(&block, WEIGHTS_ALIGNMENT, size)) {
+        perror("Memory allocation fail");
+        exit(EXIT_FAILURE);
+    }
+    memset(block, 0, size);
+    arena_init(&arena, block, size);
+    return mlp_carve(&arena, num_nodes, num_layers, parameters);
+}
+
 /*
  * Function: mlp_initialise
  * ------------------------
  * Parameters:	num_nodes - the nodes in each layer of the MLP
  *				num_layers - the number of layers in the whole
  *MLP
+ *				rng - the random number stream the weights are drawn from
  *
  * Given a list of the number of nodes in each layer including the input and
- * output, and the number of layers, it initialises a blank network on the heap
+ * output, and the number of layers, it initialises a blank network on the heap.
+ * The network is sized up front and allocated as a single block.
  */
-MLP *mlp_initialise(int *num_nodes, int num_layers) {
+MLP *mlp_initialise(int *num_nodes, int num_layers, Rng *rng) {
     assert(num_nodes != NULL);
-    MLP *mlp_net = malloc(sizeof(MLP));
-    if (!mlp_net) {
+    assert(num_layers > 1);
+    assert(rng != NULL);
+
+    MLP *mlp_net = mlp_allocate(num_nodes, num_layers, true);
+    for (Layer *l = mlp_net->input_layer->next_layer; l; l = l->next_layer) {
+        layer_randomise(l, rng);
+    }
+    return mlp_net;
+}
+
+/*
+ * Function: mlp_create
+ * --------------------
+ * Parameters:	num_nodes - the nodes in each layer of the MLP
+ *				num_layers - the number of layers in the whole MLP
+ *
+ * Same as mlp_initialise, but all the weights are left at 0 and no random
+ * numbers are drawn, for networks whose weights are about to be filled in.
+ */
+MLP *mlp_create(const int *num_nodes, int num_layers) {
+    assert(num_nodes != NULL);
+    assert(num_layers > 1);
+
+    return mlp_allocate(num_nodes, num_layers, true);
+}
+
+/*
+ * Function: mlp_view
+ * ------------------
+ * Parameters:	num_nodes - the nodes in each layer of the MLP
+ *				num_layers - the number of layers in the whole MLP
+ *				mapping - memory mapping holding the biases and weights
+ *				mapping_size - the size of the mapping
+ *
+ * Same as mlp_create, but the biases and weights of the layers are left
+ * NULL for the caller to point into mapping, so that a network can be
+ * used straight from a mapped file without copying its parameters. The
+ * network owns the mapping from then on, mlp_free unmaps it.
+ */
+MLP *mlp_view(const int *num_nodes, int num_layers, void *mapping,
+              size_t mapping_size) {
+    assert(num_nodes != NULL);
+    assert(num_layers > 1);
+    assert(mapping != NULL);
+
+    MLP *mlp = mlp_allocate(num_nodes, num_layers, false);
+    mlp->mapping = mapping;
+    mlp->mapping_size = mapping_size;
+    return mlp;
+}
+
+/*
+ * Function: mlp_randomise
+ * -----------------------
+ * Parameters:	mlp - the MLP to be reset
+ *				rng - the random number stream the weights are drawn from
+ *
+ * Puts an existing network back in the state mlp_initialise creates it in,
+ * zeroing its biases, outputs and errors and drawing new weights in the
+ * same order, so that the storage of a network can be reused for a new one
+ * of the same topology.
+ */
+void mlp_randomise(MLP *mlp, Rng *rng) {
+    assert(mlp != NULL && rng != NULL);
+    Layer *input = mlp->input_layer;
+    memset(input->outputs, 0, input->num_outputs * sizeof(mlp_real));
+    for (Layer *l = input->next_layer; l; l = l->next_layer) {
+        memset(l->outputs, 0, l->num_outputs * sizeof(mlp_real));
+        memset(l->biases, 0, l->num_outputs * sizeof(mlp_real));
+        memset(l->errors, 0, l->num_outputs * sizeof(mlp_real));
+        layer_randomise(l, rng);
+    }
+}
+
+/*
+ * Function: mlp_copy
+ * ------------------
+ * Parameters:	dest - the MLP to be overwritten
+ *				src - the MLP to copy from
+ *
+ * Copies the weights, biases and outputs of src into dest, which must have
+ * the same topology.
+ */
+void mlp_copy(MLP *dest, const MLP *src) {
+    assert(dest != NULL && src != NULL);
+    Layer *d = dest->input_layer;
+    const Layer *s = src->input_layer;
+    assert(d->num_outputs == s->num_outputs);
+    memcpy(d->outputs, s->outputs, d->num_outputs * sizeof(mlp_real));
+    for (d = d->next_layer, s = s->next_layer; d && s;
+         d = d->next_layer, s = s->next_layer) {
+        assert(d->num_inputs == s->num_inputs);
+        assert(d->num_outputs == s->num_outputs);
+        memcpy(d->outputs, s->outputs, d->num_outputs * sizeof(mlp_real));
+        memcpy(d->biases, s->biases, d->num_outputs * sizeof(mlp_real));
+        memcpy(d->errors, s->errors, d->num_outputs * sizeof(mlp_real));
+        memcpy(d->weights, s->weights,
+               (size_t)d->num_inputs * d->num_outputs * sizeof(mlp_real));
+    }
+    assert(!d && !s);
+}
+
+/*
+ * Function: mlp_clone
+ * -------------------
+ * Parameters:	mlp - the MLP to be copied
+ *
+ * Returns a new network on the heap with the same topology and parameters as
+ * the given one. No random numbers are drawn.
+ */
+MLP *mlp_clone(const MLP *mlp) {
+    assert(mlp != NULL);
+    int num_layers = 0;
+    for (const Layer *l = mlp->input_layer; l; l = l->next_layer) {
+        ++num_layers;
+    }
+    int *num_nodes = malloc(num_layers * sizeof(int));
+    if (!num_nodes) {
         perror("Memory allocation fail");
         exit(EXIT_FAILURE);
     }
-    mlp_net->input_layer = create_layer();
-    layer_initialise(mlp_net->input_layer, num_nodes[0], NULL);
-    Layer *prev = mlp_net->input_layer;
-    int i;
-    for (i = 1; i < num_layers; i++) {
-        Layer *current = create_layer();
-        layer_initialise(current, num_nodes[i], prev);
-        prev = current;
-    };
+    int i = 0;
+    for (const Layer *l = mlp->input_layer; l; l = l->next_layer) {
+        num_nodes[i++] = l->num_outputs;
+    }
 
-    mlp_net->output_layer = prev;
-    return mlp_net;
+    MLP *clone = mlp_allocate(num_nodes, num_layers, true);
+    free(num_nodes);
+    mlp_copy(clone, mlp);
+    return clone;
+}
+
+/*
+ * Function: layer_inherit
+ * -----------------------
+ * Copies the weights and biases of src that have a counterpart in dest, that
+ * is the top left submatrix of weights both layers have.
+ */
+static void layer_inherit(Layer *dest, const Layer *src) {
+    const int num_inputs =
+        dest->num_inputs < src->num_inputs ? dest->num_inputs : src->num_inputs;
+    const int num_outputs = dest->num_outputs < src->num_outputs
+                                ? dest->num_outputs
+                                : src->num_outputs;
+    for (int j = 0; j < num_outputs; j++) {
+        memcpy(&LAYER_WEIGHT(dest, 0, j), &LAYER_WEIGHT(src, 0, j),
+               num_inputs * sizeof(mlp_real));
+    }
+    memcpy(dest->biases, src->biases, num_outputs * sizeof(mlp_real));
+}
+
+/*
+ * Function: mlp_inherit
+ * ---------------------
+ * Parameters:	child - the MLP to be warm started
+ *				parent - the trained MLP to inherit from
+ *
+ * Copies the trained weights of parent into child wherever the two overlap,
+ * so that child can be trained from there instead of from scratch. Hidden
+ * layers are matched from the input onwards and the output layers with each
+ * other, so a child with fewer hidden layers gets the first ones of its
+ * parent and one with more keeps its own random weights in the extra layers.
+ * Within a pair of layers the weights between the nodes both have are copied.
+ */
+void mlp_inherit(MLP *child, const MLP *parent) {
+    assert(child != NULL && parent != NULL);
+    Layer *c = child->input_layer->next_layer;
+    const Layer *p = parent->input_layer->next_layer;
+    // the output layers are handled separately
+    while (c->next_layer && p->next_layer) {
+        layer_inherit(c, p);
+        c = c->next_layer;
+        p = p->next_layer;
+    }
+    layer_inherit(child->output_layer, parent->output_layer);
 }
@@ -2,21 +2,95 @@
 #define MLP_H
 
 #include <stdbool.h>
+#include <stddef.h>
+
+#include "rng.h"
+
+/*
+ * typedef: mlp_real
+ * -----------------
+ * The floating point type of the weights, biases, outputs and errors of
+ * the network. Building with PRECISION=single (which defines
+ * MLP_SINGLE_PRECISION) makes it float, halving the memory traffic and
+ * doubling the width of the vector kernels. Data is still passed in and
+ * out of the network as doubles.
+ */
+#ifdef MLP_SINGLE_PRECISION
+typedef float mlp_real;
+#else
+typedef double mlp_real;
+#endif
 
+/*
+ * typedef struct: mlp_layer
+ * -------------------------
+ * weights - one contiguous, WEIGHTS_ALIGNMENT aligned block of
+ *           num_outputs * num_inputs values stored row-major by output node,
+ *           so the weights feeding output j are weights[j * num_inputs + i].
+ *           Use LAYER_WEIGHT to index it.
+ */
 typedef struct mlp_layer {
     int num_inputs, num_outputs;
     struct mlp_layer *previous_layer, *next_layer;
-    double *outputs;
-    double *biases;
-    double *errors;
-    double **weights;
+    mlp_real *outputs;
+    mlp_real *biases;
+    mlp_real *errors;
+    mlp_real *weights;
 } Layer;
 
+#define WEIGHTS_ALIGNMENT 64
+
+#define LAYER_WEIGHT(layer, i, j) \
+    ((layer)->weights[(size_t)(j) * (layer)->num_inputs + (i)])
+
+/*
+ * typedef struct: mlp_net
+ * -----------------------
+ * mapping, mapping_size - the memory mapping the biases and weights live in
+ *                         for a network made by mlp_view, NULL otherwise
+ */
 typedef struct mlp_net {
     struct mlp_layer *input_layer;
     struct mlp_layer *output_layer;
+    void *mapping;
+    size_t mapping_size;
 } MLP;
 
+/*
+ * typedef struct: mlp_context
+ * ---------------------------
+ * The activations of one inference, kept out of the network so that one
+ * network can be shared by many threads, each running mlp_forward with a
+ * context of its own.
+ * num_layers - the number of layers of the network it was made for
+ * outputs - for each layer, including the input one, its outputs
+ */
+typedef struct mlp_context {
+    int num_layers;
+    mlp_real **outputs;
+} MLPContext;
+
+/*
+ * typedef struct: early_stopping
+ * ------------------------------
+ * When train_early_stopping gives up on a network
+ * check_interval - the number of epochs between two checks of the held-out
+ *                  cost
+ * patience - the number of checks in a row without improvement after which
+ *            training stops
+ * min_delta - how much lower than the best cost so far the held-out cost
+ *             has to be to count as an improvement
+ * inputs, targets, num_rows - the held-out set the cost is checked on
+ */
+typedef struct early_stopping {
+    int check_interval;
+    int patience;
+    double min_delta;
+    double **inputs;
+    double **targets;
+    int num_rows;
+} EarlyStopping;
+
 extern double sigmoid(double x);
 
 extern double sig_prime(double x);
@@ -25,28 +99,54 @@ extern double relu(double x);
 
 extern double relu_prime(double x);
 
-extern double random_deviation_num();
-
-extern Layer *create_layer(void);
-
-extern void layer_initialise(Layer *layer, int num_outputs,
-                             Layer *previous_layer);
-
 extern void back_prop(MLP *mlp, double *target, double learning_rate);
 
 extern void train(MLP *mlp, double **input_vals, int num_inputs,
                   double **targets, double learning_rate, int epochs);
 
+extern void train_batch(MLP *mlp, double **input_vals, int num_inputs,
+                        double **targets, double learning_rate, int epochs,
+                        int batch_size);
+
+extern int train_early_stopping(MLP *mlp, double **input_vals, int num_inputs,
+                                double **targets, double learning_rate,
+                                int max_epochs, int batch_size,
+                                const EarlyStopping *stopping);
+
 extern double cost(MLP *mlp, double **targets, double **inputs, int no_rows);
 
-extern void layer_free(Layer *layer);
+extern void predict_batch(const MLP *mlp, const double *inputs, int num_rows,
+                          double *outputs, int workers);
+
+extern void predict_strided(const MLP *mlp, const double *inputs, int stride,
+                            int num_rows, double *outputs, int workers);
 
 extern void mlp_free(MLP *mlp);
 
-extern MLP *mlp_initialise(int *num_nodes, int num_layers);
+extern MLP *mlp_initialise(int *num_nodes, int num_layers, Rng *rng);
+
+extern MLP *mlp_create(const int *num_nodes, int num_layers);
+
+extern MLP *mlp_view(const int *num_nodes, int num_layers, void *mapping,
+                     size_t mapping_size);
+
+extern void mlp_randomise(MLP *mlp, Rng *rng);
+
+extern void mlp_copy(MLP *dest, const MLP *src);
+
+extern MLP *mlp_clone(const MLP *mlp);
+
+extern void mlp_inherit(MLP *child, const MLP *parent);
 
 extern void output_calc(Layer *layer, bool use_sigmoid);
 
 extern void forward_prop(MLP *mlp, double *input_vals);
 
+extern MLPContext *mlp_context_create(const MLP *mlp);
+
+extern void mlp_context_free(MLPContext *context);
+
+extern void mlp_forward(const MLP *mlp, MLPContext *context,
+                        const double *input_vals, double *output_vals);
+
 #endif
@@ -0,0 +1,128 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <math.h>
+
+#include "mlp.h"
+#include "testutils.h"
+#include "parallel.h"
+
+#define ROWS 37
+#define FEATURES 6
+#define PREDICT_ROWS 600
+
+/*
+ * Builds a network with the same random weights every time it is called
+ */
+static MLP *seeded_mlp(void) {
+    int layers[] = {FEATURES, 9, 7, 1};
+    Rng rng;
+    rng_seed(&rng, 1234);
+    return mlp_initialise(layers, 4, &rng);
+}
+
+static bool same_weights(MLP *mlp1, MLP *mlp2) {
+    Layer *l1 = mlp1->input_layer->next_layer;
+    Layer *l2 = mlp2->input_layer->next_layer;
+    for (; l1 && l2; l1 = l1->next_layer, l2 = l2->next_layer) {
+        for (int i = 0; i < l1->num_inputs * l1->num_outputs; i++) {
+            if (l1->weights[i] != l2->weights[i]) {
+                return false;
+            }
+        }
+        for (int j = 0; j < l1->num_outputs; j++) {
+            if (l1->biases[j] != l2->biases[j]) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+/*
+ * Each task predicts one row of the block on the shared network with a
+ * context of its own
+ */
+typedef struct shared_inference {
+    const MLP *mlp;
+    const double *block;
+    double *outputs;
+} SharedInference;
+
+static void forward_row(int index, void *arg) {
+    SharedInference *shared = arg;
+    MLPContext *context = mlp_context_create(shared->mlp);
+    mlp_forward(shared->mlp, context, shared->block + index * FEATURES,
+                shared->outputs + index);
+    mlp_context_free(context);
+}
+
+int main(void) {
+    double data[ROWS][FEATURES];
+    double expected[ROWS][1];
+    double *inputs[ROWS];
+    double *targets[ROWS];
+    for (int r = 0; r < ROWS; r++) {
+        double sum = 0;
+        for (int i = 0; i < FEATURES; i++) {
+            data[r][i] = (double)((r * 7 + i * 3) % 11) / 11;
+            sum += data[r][i];
+        }
+        expected[r][0] = sum / FEATURES;
+        inputs[r] = data[r];
+        targets[r] = expected[r];
+    }
+
+    MLP *online = seeded_mlp();
+    MLP *batched = seeded_mlp();
+    train(online, inputs, ROWS, targets, 0.1, 20);
+    train_batch(batched, inputs, ROWS, targets, 0.1, 20, 1);
+    testbool(same_weights(online, batched),
+             "Batch size 1 matches online training");
+    mlp_free(online);
+    mlp_free(batched);
+
+    MLP *untrained = seeded_mlp();
+    double before = cost(untrained, targets, inputs, ROWS);
+    batched = seeded_mlp();
+    train_batch(batched, inputs, ROWS, targets, 0.1, 200, 8);
+    testbool(cost(batched, targets, inputs, ROWS) < before,
+             "Batch size 8 reduces the cost");
+    mlp_free(untrained);
+    mlp_free(batched);
+
+    // more rows than fit in one block of predict_batch
+    static double block[PREDICT_ROWS * FEATURES];
+    static double serial[PREDICT_ROWS], threaded[PREDICT_ROWS];
+    for (int i = 0; i < PREDICT_ROWS * FEATURES; i++) {
+        block[i] = (double)((i * 13) % 17) / 17;
+    }
+    MLP *mlp = seeded_mlp();
+    predict_batch(mlp, block, PREDICT_ROWS, serial, 1);
+    predict_batch(mlp, block, PREDICT_ROWS, threaded, 3);
+    bool matches = true;
+    bool same = true;
+    for (int r = 0; r < PREDICT_ROWS; r++) {
+        forward_prop(mlp, block + r * FEATURES);
+        matches = matches && fabs(serial[r] - mlp->output_layer->outputs[0]) <
+                                 1e-9 * (1 + fabs(serial[r]));
+        same = same && serial[r] == threaded[r];
+    }
+    testbool(matches, "Batch prediction matches forward propagation");
+    testbool(same, "Batch prediction does not depend on the workers");
+
+    static double shared_outputs[PREDICT_ROWS];
+    SharedInference shared = {mlp, block, shared_outputs};
+    parallel_for(PREDICT_ROWS, 4, NULL, forward_row, &shared);
+    same = true;
+    for (int r = 0; r < PREDICT_ROWS; r++) {
+        forward_prop(mlp, block + r * FEATURES);
+        same = same && shared_outputs[r] == mlp->output_layer->outputs[0];
+    }
+    testbool(same, "Threads sharing a network with their own contexts "
+                   "match forward propagation");
+    mlp_free(mlp);
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,123 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "mlp.h"
+#include "testutils.h"
+
+#define FEATURES 4
+
+static MLP *seeded_mlp(const int *hidden, int num_hidden, uint64_t seed) {
+    int layers[num_hidden + 2];
+    layers[0] = FEATURES;
+    for (int k = 0; k < num_hidden; k++) {
+        layers[k + 1] = hidden[k];
+    }
+    layers[num_hidden + 1] = 1;
+    Rng rng;
+    rng_seed(&rng, seed);
+    return mlp_initialise(layers, num_hidden + 2, &rng);
+}
+
+/*
+ * Returns true iff the weights between the nodes both layers have, and the
+ * biases of those nodes, are the same
+ */
+static bool same_overlap(const Layer *l1, const Layer *l2) {
+    const int num_inputs =
+        l1->num_inputs < l2->num_inputs ? l1->num_inputs : l2->num_inputs;
+    const int num_outputs =
+        l1->num_outputs < l2->num_outputs ? l1->num_outputs : l2->num_outputs;
+    for (int j = 0; j < num_outputs; j++) {
+        for (int i = 0; i < num_inputs; i++) {
+            if (LAYER_WEIGHT(l1, i, j) != LAYER_WEIGHT(l2, i, j)) {
+                return false;
+            }
+        }
+        if (l1->biases[j] != l2->biases[j]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static Layer *hidden_layer(const MLP *mlp, int k) {
+    Layer *layer = mlp->input_layer;
+    for (int i = 0; i <= k; i++) {
+        layer = layer->next_layer;
+    }
+    return layer;
+}
+
+void test_same_topology(void) {
+    const int hidden[] = {6, 6};
+    MLP *parent = seeded_mlp(hidden, 2, 1);
+    MLP *child = seeded_mlp(hidden, 2, 2);
+    mlp_inherit(child, parent);
+    bool same = true;
+    for (int k = 0; k < 3; k++) {
+        same = same && same_overlap(hidden_layer(child, k),
+                                    hidden_layer(parent, k));
+    }
+    testbool(same, "A child of the same topology is an exact copy");
+
+    const int narrower[] = {5, 5};
+    MLP *narrow = seeded_mlp(narrower, 2, 3);
+    MLP *untouched = mlp_clone(narrow);
+    mlp_inherit(narrow, parent);
+    same = true;
+    for (int k = 0; k < 3; k++) {
+        same = same && same_overlap(hidden_layer(narrow, k),
+                                    hidden_layer(parent, k));
+    }
+    testbool(same && !same_overlap(hidden_layer(narrow, 0),
+                                   hidden_layer(untouched, 0)),
+             "A narrower child gets the weights of the nodes it has");
+
+    mlp_free(parent);
+    mlp_free(child);
+    mlp_free(narrow);
+    mlp_free(untouched);
+}
+
+void test_fewer_layers(void) {
+    const int parent_hidden[] = {6, 6, 6};
+    const int child_hidden[] = {6};
+    MLP *parent = seeded_mlp(parent_hidden, 3, 4);
+    MLP *child = seeded_mlp(child_hidden, 1, 5);
+    mlp_inherit(child, parent);
+    testbool(same_overlap(hidden_layer(child, 0), hidden_layer(parent, 0)),
+             "A shallower child gets the first hidden layers");
+    testbool(same_overlap(child->output_layer, parent->output_layer),
+             "A shallower child gets the output layer");
+    mlp_free(parent);
+    mlp_free(child);
+}
+
+void test_more_layers(void) {
+    const int parent_hidden[] = {6};
+    const int child_hidden[] = {6, 6, 6};
+    MLP *parent = seeded_mlp(parent_hidden, 1, 6);
+    MLP *child = seeded_mlp(child_hidden, 3, 7);
+    MLP *untouched = mlp_clone(child);
+    mlp_inherit(child, parent);
+    testbool(same_overlap(hidden_layer(child, 0), hidden_layer(parent, 0)),
+             "A deeper child gets the hidden layers its parent has");
+    testbool(same_overlap(hidden_layer(child, 1), hidden_layer(untouched, 1)) &&
+                 same_overlap(hidden_layer(child, 2),
+                              hidden_layer(untouched, 2)),
+             "The extra layers of a deeper child keep their random weights");
+    testbool(same_overlap(child->output_layer, parent->output_layer),
+             "A deeper child gets the output layer");
+    mlp_free(parent);
+    mlp_free(child);
+    mlp_free(untouched);
+}
+
+int main(void) {
+    test_same_topology();
+    test_fewer_layers();
+    test_more_layers();
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,217 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <math.h>
+#include <string.h>
+
+#include "kernels.h"
+#include "testutils.h"
+
+#define MAX_LENGTH 67
+#ifdef MLP_SINGLE_PRECISION
+#define TOLERANCE 1e-5
+#else
+#define TOLERANCE 1e-12
+#endif
+
+static void fill(mlp_real *x, int n) {
+    for (int i = 0; i < n; i++) {
+        x[i] = (double)rand() / RAND_MAX * 2 - 1;
+    }
+}
+
+static bool close_to(mlp_real result, mlp_real expected) {
+    return fabs(result - expected) <= TOLERANCE * (1 + fabs(expected));
+}
+
+/*
+ * Checks the given kernels against the scalar ones for every length up to
+ * MAX_LENGTH, so that all the vector tails are exercised
+ */
+static void test_kernels(const MLPKernels *kernels) {
+    const MLPKernels *scalar = mlp_scalar_kernels();
+    mlp_real w[MAX_LENGTH], x[4][MAX_LENGTH], y1[MAX_LENGTH],
+        y2[MAX_LENGTH];
+    bool dot = true, dot4 = true, axpy = true;
+
+    for (int n = 0; n <= MAX_LENGTH; n++) {
+        fill(w, n);
+        for (int k = 0; k < 4; k++) {
+            fill(x[k], n);
+        }
+        fill(y1, n);
+        for (int i = 0; i < n; i++) {
+            y2[i] = y1[i];
+        }
+
+        dot = dot && close_to(kernels->dot(w, x[0], n), scalar->dot(w, x[0], n));
+
+        mlp_real out1[4], out2[4];
+        kernels->dot4(w, x[0], x[1], x[2], x[3], n, out1);
+        scalar->dot4(w, x[0], x[1], x[2], x[3], n, out2);
+        for (int k = 0; k < 4; k++) {
+            dot4 = dot4 && close_to(out1[k], out2[k]);
+        }
+
+        kernels->axpy(0.37, w, y1, n);
+        scalar->axpy(0.37, w, y2, n);
+        for (int i = 0; i < n; i++) {
+            axpy = axpy && close_to(y1[i], y2[i]);
+        }
+    }
+
+    bool sigmoid = true, relu = true, sigmoid_prime = true;
+    for (int n = 0; n <= MAX_LENGTH; n++) {
+        for (int i = 0; i < n; i++) {
+            y1[i] = y2[i] = ((double)rand() / RAND_MAX * 2 - 1) * 40;
+        }
+        kernels->sigmoid(y1, n);
+        scalar->sigmoid(y2, n);
+        for (int i = 0; i < n; i++) {
+            sigmoid = sigmoid && close_to(y1[i], y2[i]);
+        }
+
+        for (int i = 0; i < n; i++) {
+            y1[i] = y2[i] = (double)rand() / RAND_MAX * 2 - 1;
+        }
+        kernels->relu(y1, n);
+        scalar->relu(y2, n);
+        for (int i = 0; i < n; i++) {
+            relu = relu && y1[i] == y2[i];
+        }
+
+        fill(w, n);
+        kernels->sigmoid_prime_mul(w, y1, n);
+        scalar->sigmoid_prime_mul(w, y2, n);
+        for (int i = 0; i < n; i++) {
+            sigmoid_prime = sigmoid_prime && close_to(y1[i], y2[i]);
+        }
+    }
+
+    char name[64];
+    snprintf(name, sizeof(name), "%s dot matches scalar", kernels->name);
+    testbool(dot, name);
+    snprintf(name, sizeof(name), "%s dot4 matches scalar", kernels->name);
+    testbool(dot4, name);
+    snprintf(name, sizeof(name), "%s axpy matches scalar", kernels->name);
+    testbool(axpy, name);
+    snprintf(name, sizeof(name), "%s sigmoid matches libm", kernels->name);
+    testbool(sigmoid, name);
+    snprintf(name, sizeof(name), "%s relu matches scalar", kernels->name);
+    testbool(relu, name);
+    snprintf(name, sizeof(name), "%s sigmoid prime matches scalar",
+             kernels->name);
+    testbool(sigmoid_prime, name);
+}
+
+/*
+ * Checks that NaN and infinities go through every kernel of the set as
+ * through the scalar maths, so that a diverged network never gets a finite
+ * cost. Special values are put in every lane of the vectors and the tails.
+ */
+static void test_special_values(const MLPKernels *kernels) {
+    const mlp_real specials[] = {NAN, INFINITY, -INFINITY, (mlp_real)-2.5};
+    mlp_real x[MAX_LENGTH], y[MAX_LENGTH], w[MAX_LENGTH];
+    bool relu = true, sigmoid = true, dense = true;
+
+    for (int n = 1; n <= MAX_LENGTH; n++) {
+        for (int i = 0; i < n; i++) {
+            x[i] = y[i] = specials[(i + n) % 4];
+        }
+        kernels->relu(x, n);
+        kernels->sigmoid(y, n);
+        for (int i = 0; i < n; i++) {
+            const mlp_real v = specials[(i + n) % 4];
+            if (isnan(v)) {
+                relu = relu && isnan(x[i]);
+                sigmoid = sigmoid && isnan(y[i]);
+            } else if (isinf(v)) {
+                relu = relu && x[i] == v;
+                sigmoid = sigmoid && close_to(y[i], v > 0 ? 1 : 0);
+            } else {
+                relu = relu && x[i] == (mlp_real)RELU_LEAK * v;
+            }
+        }
+
+        // one NaN anywhere in the inputs makes every result NaN
+        fill(w, n);
+        fill(x, n);
+        fill(y, n);
+        x[n - 1] = NAN;
+        mlp_real out[4];
+        kernels->dot4(w, x, x, x, x, n, out);
+        kernels->axpy(0.5, x, y, n);
+        dense = dense && isnan(kernels->dot(w, x, n)) && isnan(out[0]) &&
+                isnan(out[3]) && isnan(y[n - 1]);
+        kernels->sigmoid_prime_mul(w, x, n);
+        dense = dense && isnan(x[n - 1]);
+    }
+
+    char name[64];
+    snprintf(name, sizeof(name), "%s relu keeps NaN and infinities",
+             kernels->name);
+    testbool(relu, name);
+    snprintf(name, sizeof(name), "%s sigmoid keeps NaN", kernels->name);
+    testbool(sigmoid, name);
+    snprintf(name, sizeof(name), "%s dense kernels propagate NaN",
+             kernels->name);
+    testbool(dense, name);
+}
+
+/*
+ * Checks that the row kernels of the set give exactly the results of its
+ * generic kernels, and that lengths without row kernels get the generic ones
+ */
+static void test_row_kernels(const MLPKernels *kernels) {
+    mlp_real w[MAX_LENGTH], x[4][MAX_LENGTH], y1[MAX_LENGTH],
+        y2[MAX_LENGTH];
+    bool same = true;
+    int count = 0;
+
+    for (const MLPRowKernels *rows = kernels->rows; rows->n; rows++, count++) {
+        const int n = rows->n;
+        same = same && mlp_row_kernels(kernels, n) == rows && n <= MAX_LENGTH;
+        fill(w, n);
+        for (int k = 0; k < 4; k++) {
+            fill(x[k], n);
+        }
+        fill(y1, n);
+        memcpy(y2, y1, n * sizeof(mlp_real));
+
+        const mlp_real dot1 = rows->dot(w, x[0], n);
+        const mlp_real dot2 = kernels->dot(w, x[0], n);
+        mlp_real out1[4], out2[4];
+        rows->dot4(w, x[0], x[1], x[2], x[3], n, out1);
+        kernels->dot4(w, x[0], x[1], x[2], x[3], n, out2);
+        rows->axpy(0.37, w, y1, n);
+        kernels->axpy(0.37, w, y2, n);
+        same = same && !memcmp(&dot1, &dot2, sizeof(mlp_real)) &&
+               !memcmp(out1, out2, sizeof(out1)) &&
+               !memcmp(y1, y2, n * sizeof(mlp_real));
+    }
+
+    const MLPRowKernels *generic = mlp_row_kernels(kernels, MAX_LENGTH);
+    char name[64];
+    snprintf(name, sizeof(name), "%s row kernels match the generic ones",
+             kernels->name);
+    testbool(same && count > 0, name);
+    snprintf(name, sizeof(name), "%s other lengths use the generic kernels",
+             kernels->name);
+    testbool(generic->n == 0 && generic->dot == kernels->dot &&
+                 generic->dot4 == kernels->dot4 &&
+                 generic->axpy == kernels->axpy,
+             name);
+}
+
+int main(void) {
+    const MLPKernels *supported[8];
+    int count = mlp_supported_kernels(supported, 8);
+    printf("Selected kernels: %s\n", mlp_kernels()->name);
+    for (int i = 0; i < count; i++) {
+        test_kernels(supported[i]);
+        test_row_kernels(supported[i]);
+        test_special_values(supported[i]);
+    }
+    return EXIT_SUCCESS;
+}
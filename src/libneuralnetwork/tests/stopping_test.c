@@ -0,0 +1,108 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <math.h>
+
+#include "mlp.h"
+#include "testutils.h"
+
+#define ROWS 40
+#define HELD_OUT 10
+#define FEATURES 4
+#define MAX_EPOCHS 2000
+#define DIVERGING_RATE 1000
+
+static MLP *seeded_mlp(void) {
+    int layers[] = {FEATURES, 8, 1};
+    Rng rng;
+    rng_seed(&rng, 4321);
+    return mlp_initialise(layers, 3, &rng);
+}
+
+static bool finite_weights(const MLP *mlp) {
+    for (const Layer *l = mlp->input_layer->next_layer; l; l = l->next_layer) {
+        for (int i = 0; i < l->num_inputs * l->num_outputs; i++) {
+            if (!isfinite(l->weights[i])) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+int main(void) {
+    double data[ROWS][FEATURES];
+    double expected[ROWS][1];
+    double *inputs[ROWS];
+    double *targets[ROWS];
+    for (int r = 0; r < ROWS; r++) {
+        double sum = 0;
+        for (int i = 0; i < FEATURES; i++) {
+            data[r][i] = (double)((r * 5 + i * 3) % 13) / 13;
+            sum += data[r][i];
+        }
+        expected[r][0] = sum / FEATURES;
+        inputs[r] = data[r];
+        targets[r] = expected[r];
+    }
+
+    EarlyStopping stopping = {.check_interval = 10,
+                              .patience = 3,
+                              .min_delta = 1e-6,
+                              .inputs = inputs,
+                              .targets = targets,
+                              .num_rows = HELD_OUT};
+
+    MLP *stopped = seeded_mlp();
+    int epochs = train_early_stopping(stopped, inputs + HELD_OUT,
+                                      ROWS - HELD_OUT, targets + HELD_OUT, 0.1,
+                                      MAX_EPOCHS, 1, &stopping);
+    testbool(epochs > 0 && epochs < MAX_EPOCHS,
+             "Training stops once the held-out cost plateaus");
+    testbool(epochs % stopping.check_interval == 0,
+             "Training stops on a check");
+
+    MLP *last = seeded_mlp();
+    train_batch(last, inputs + HELD_OUT, ROWS - HELD_OUT, targets + HELD_OUT,
+                0.1, epochs, 1);
+    testbool(cost(stopped, targets, inputs, HELD_OUT) <=
+                 cost(last, targets, inputs, HELD_OUT) + stopping.min_delta,
+             "The best weights on the held-out rows are kept");
+    mlp_free(stopped);
+    mlp_free(last);
+
+    double nan_target[1] = {NAN};
+    double *nan_targets[HELD_OUT];
+    for (int r = 0; r < HELD_OUT; r++) {
+        nan_targets[r] = nan_target;
+    }
+    stopping.targets = nan_targets;
+    MLP *diverged = seeded_mlp();
+    epochs = train_early_stopping(diverged, inputs + HELD_OUT,
+                                  ROWS - HELD_OUT, targets + HELD_OUT, 0.1,
+                                  MAX_EPOCHS, 1, &stopping);
+    testbool(epochs == stopping.check_interval,
+             "Training stops as soon as the held-out cost is not finite");
+    mlp_free(diverged);
+
+    // a learning rate this high makes the weights themselves blow up after
+    // a couple of epochs, with finite targets
+    EarlyStopping every_epoch = {.check_interval = 1,
+                                 .patience = MAX_EPOCHS,
+                                 .inputs = inputs,
+                                 .targets = targets,
+                                 .num_rows = HELD_OUT};
+    MLP *exploded = seeded_mlp();
+    epochs = train_early_stopping(exploded, inputs + HELD_OUT,
+                                  ROWS - HELD_OUT, targets + HELD_OUT,
+                                  DIVERGING_RATE, MAX_EPOCHS, 1, &every_epoch);
+    testbool(epochs > 1 && epochs < MAX_EPOCHS,
+             "Training stops once the weights diverge");
+    testbool(isfinite(cost(exploded, targets, inputs, HELD_OUT)) &&
+                 finite_weights(exploded),
+             "The last finite weights are restored after diverging");
+    mlp_free(exploded);
+
+    return EXIT_SUCCESS;
+}
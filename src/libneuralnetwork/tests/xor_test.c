@@ -5,7 +5,9 @@
 
 int main(void) {
     int layers[] = {2, 3, 1};
-    MLP *net = mlp_initialise(layers, 3);
+    Rng rng;
+    rng_seed(&rng, 1);
+    MLP *net = mlp_initialise(layers, 3, &rng);
 
     double input1[] = {0, 0};
     double input2[] = {0, 1};
@@ -0,0 +1,44 @@
+#include <assert.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "arena.h"
+
+/*
+ * Function: arena_init
+ * --------------------
+ * Sets up an arena over the given block. The block should be aligned to
+ * the largest alignment that will be asked of arena_alloc. Passing a NULL
+ * base gives a measuring arena: arena_alloc then returns NULL but still
+ * advances used, so running the same allocations through it first gives
+ * the exact size of the block to allocate.
+ *
+ * arena: arena to initialise
+ * base: start of the block or NULL
+ * size: size of the block, ignored when measuring
+ */
+void arena_init(Arena *arena, void *base, size_t size) {
+    assert(arena);
+    arena->base = base;
+    arena->size = base ? size : SIZE_MAX;
+    arena->used = 0;
+}
+
+/*
+ * Function: arena_alloc
+ * ---------------------
+ * Hands out size bytes aligned to alignment (a power of 2) relative to the
+ * start of the block. Memory is never given back individually, the whole
+ * block is freed at once by its owner.
+ *
+ * return: pointer to the allocation, NULL for a measuring arena
+ */
+void *arena_alloc(Arena *arena, size_t size, size_t alignment) {
+    assert(arena);
+    assert(alignment && !(alignment & (alignment - 1)));
+
+    size_t offset = (arena->used + alignment - 1) & ~(alignment - 1);
+    assert(offset + size <= arena->size);
+    arena->used = offset + size;
+    return arena->base ? arena->base + offset : NULL;
+}
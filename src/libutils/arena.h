@@ -0,0 +1,27 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stddef.h>
+
+#define ARENA_DEFAULT_ALIGNMENT 16
+
+/*
+ * typedef struct: arena
+ * ---------------------
+ * A bump allocator carving allocations out of one block of memory.
+ * base - the start of the block, or NULL for an arena that only measures
+ *        how much memory a sequence of allocations needs
+ * size - the size of the block
+ * used - the number of bytes handed out so far, including padding
+ */
+typedef struct arena {
+    char *base;
+    size_t size;
+    size_t used;
+} Arena;
+
+extern void arena_init(Arena *arena, void *base, size_t size);
+
+extern void *arena_alloc(Arena *arena, size_t size, size_t alignment);
+
+#endif
@@ -0,0 +1,113 @@
+#include <assert.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "parallel.h"
+
+/*
+ * typedef struct: work_queue
+ * --------------------------
+ * A shared queue of task indexes handed out one at a time to whichever
+ * worker asks first, so a worker that drew a small task simply comes back
+ * for more instead of idling behind a large one.
+ *
+ * next - position of the next task to hand out
+ * count - the total number of tasks
+ * order - optional permutation giving the order the tasks are handed out in
+ */
+typedef struct work_queue {
+    pthread_mutex_t lock;
+    int next;
+    int count;
+    const int *order;
+    parallel_task task;
+    void *arg;
+} WorkQueue;
+
+/*
+ * Function: parallel_default_workers
+ * ----------------------------------
+ * Returns the number of online processors, which is the default number of
+ * workers used by the parallel parts of the program.
+ */
+int parallel_default_workers(void) {
+    long processors = sysconf(_SC_NPROCESSORS_ONLN);
+    return processors > 0 ? (int)processors : 1;
+}
+
+/*
+ * Function: next_task
+ * -------------------
+ * Pops the next task index off the queue, returns -1 once it is empty.
+ */
+static int next_task(WorkQueue *queue) {
+    int index = -1;
+    pthread_mutex_lock(&queue->lock);
+    if (queue->next < queue->count) {
+        index = queue->order ? queue->order[queue->next] : queue->next;
+        queue->next++;
+    }
+    pthread_mutex_unlock(&queue->lock);
+    return index;
+}
+
+static void *worker(void *arg) {
+    WorkQueue *queue = arg;
+    int index;
+    while ((index = next_task(queue)) >= 0) {
+        queue->task(index, queue->arg);
+    }
+    return NULL;
+}
+
+/*
+ * Function: parallel_for
+ * ----------------------
+ * Runs task(i, arg) for every i in [0, count) on up to workers threads
+ * (the calling thread being one of them) and returns once all of them
+ * are done.
+ *
+ * count: number of tasks
+ * workers: maximum number of threads to use, values < 2 run everything
+ *          on the calling thread
+ * order: NULL, or a permutation of [0, count) giving the order the tasks
+ *        are started in, e.g. the most expensive ones first
+ * task: function run for each index, it must only touch data owned by
+ *       that index
+ * arg: passed through to task
+ */
+void parallel_for(int count, int workers, const int *order,
+                  parallel_task task, void *arg) {
+    assert(task);
+    assert(count >= 0);
+
+    WorkQueue queue = {.next = 0,
+                       .count = count,
+                       .order = order,
+                       .task = task,
+                       .arg = arg};
+    pthread_mutex_init(&queue.lock, NULL);
+
+    if (workers > count) {
+        workers = count;
+    }
+
+    pthread_t threads[workers > 1 ? workers - 1 : 1];
+    int started = 0;
+    for (int i = 0; i < workers - 1; ++i) {
+        if (pthread_create(&threads[i], NULL, worker, &queue)) {
+            perror("Could not create a worker thread");
+            break;
+        }
+        started++;
+    }
+
+    worker(&queue);
+
+    for (int i = 0; i < started; ++i) {
+        pthread_join(threads[i], NULL);
+    }
+    pthread_mutex_destroy(&queue.lock);
+}
@@ -0,0 +1,11 @@
+#ifndef PARALLEL_H
+#define PARALLEL_H
+
+typedef void (*parallel_task)(int index, void *arg);
+
+extern int parallel_default_workers(void);
+
+extern void parallel_for(int count, int workers, const int *order,
+                         parallel_task task, void *arg);
+
+#endif
@@ -0,0 +1,161 @@
+#include <assert.h>
+#include <math.h>
+#include <stdint.h>
+
+#include "rng.h"
+
+// the number of pairs of uniform numbers rng_gaussian draws before
+// transforming them
+#define GAUSSIAN_BLOCK 32
+
+/*
+ * Function: splitmix64
+ * --------------------
+ * Advances a splitmix64 sequence and returns its next value. Used to spread
+ * a 64 bit seed over the whole state of a generator, as recommended by the
+ * authors of xoshiro, so that close seeds still give unrelated sequences.
+ */
+static uint64_t splitmix64(uint64_t *x) {
+    uint64_t z = (*x += 0x9e3779b97f4a7c15ULL);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    return z ^ (z >> 31);
+}
+
+static uint64_t rotl(uint64_t x, int k) { return (x << k) | (x >> (64 - k)); }
+
+/*
+ * Function: rng_seed
+ * ------------------
+ * Resets the generator to the start of the sequence given by seed. The
+ * same seed always gives the same sequence, on every machine.
+ */
+void rng_seed(Rng *rng, uint64_t seed) {
+    assert(rng);
+    for (int i = 0; i < 4; i++) {
+        rng->state[i] = splitmix64(&seed);
+    }
+}
+
+/*
+ * Function: rng_stream
+ * --------------------
+ * Resets the generator to the start of stream number stream of seed, for
+ * when several generators (one per thread, per process, ...) have to be
+ * derived from one master seed. Different streams of the same seed are
+ * seeded from unrelated points of the splitmix64 sequence.
+ */
+void rng_stream(Rng *rng, uint64_t seed, uint64_t stream) {
+    assert(rng);
+    uint64_t mixed = stream;
+    rng_seed(rng, seed ^ splitmix64(&mixed));
+}
+
+/*
+ * Function: rng_split
+ * -------------------
+ * Seeds child from the next number of parent, giving it a stream of its
+ * own. Splitting off a child per task in a fixed order keeps a run
+ * reproducible however the tasks are later scheduled.
+ */
+void rng_split(Rng *child, Rng *parent) {
+    assert(child && parent);
+    rng_seed(child, rng_next(parent));
+}
+
+/*
+ * Function: rng_next
+ * ------------------
+ * Returns the next 64 bits of the sequence (xoshiro256**)
+ */
+uint64_t rng_next(Rng *rng) {
+    uint64_t *s = rng->state;
+    const uint64_t result = rotl(s[1] * 5, 7) * 9;
+    const uint64_t t = s[1] << 17;
+
+    s[2] ^= s[0];
+    s[3] ^= s[1];
+    s[1] ^= s[2];
+    s[0] ^= s[3];
+    s[2] ^= t;
+    s[3] = rotl(s[3], 45);
+
+    return result;
+}
+
+/*
+ * Function: rng_double
+ * --------------------
+ * Returns a uniformly distributed double in [0, 1), using the top 53 bits
+ * of the next number so that every representable multiple of 2^-53 is
+ * equally likely.
+ */
+double rng_double(Rng *rng) { return (rng_next(rng) >> 11) * 0x1.0p-53; }
+
+/*
+ * Function: rng_int
+ * -----------------
+ * Returns a uniformly distributed int between min and max, both included.
+ * The range is mapped with a multiplication rather than a modulo, and the
+ * few numbers that would make some values more likely than others are
+ * rejected. The full range of int takes the top 32 bits as they are.
+ */
+int rng_int(Rng *rng, int min, int max) {
+    assert(min <= max);
+    if ((int64_t)max - min == UINT32_MAX) {
+        // every int is in range, which does not fit in 32 bits
+        return (int)((int64_t)min + (int64_t)(rng_next(rng) >> 32));
+    }
+    const uint32_t range = (uint32_t)((int64_t)max - min + 1);
+    const uint32_t threshold = -range % range;
+    uint64_t product;
+    do {
+        product = (rng_next(rng) >> 32) * range;
+    } while ((uint32_t)product < threshold);
+    return (int)(min + (int64_t)(product >> 32));
+}
+
+/*
+ * Function: rng_gaussian
+ * ----------------------
+ * Fills values with count normally distributed numbers (Box-Muller).
+ * The uniform numbers are drawn a block at a time and then transformed in
+ * a separate branch free loop the compiler can vectorise, and both the
+ * cosine and the sine of each pair are kept, halving the number of
+ * logarithms and square roots per value.
+ *
+ * rng: the generator to draw from
+ * values: where the numbers go
+ * count: the number of values to draw
+ * mean, std_dev: the parameters of the distribution
+ */
+void rng_gaussian(Rng *rng, double *values, int count, double mean,
+                  double std_dev) {
+    assert(rng && (values || count == 0));
+    double radius[GAUSSIAN_BLOCK], angle[GAUSSIAN_BLOCK];
+
+    for (int start = 0; start < count; start += 2 * GAUSSIAN_BLOCK) {
+        int pairs = (count - start + 1) / 2;
+        if (pairs > GAUSSIAN_BLOCK) {
+            pairs = GAUSSIAN_BLOCK;
+        }
+        for (int k = 0; k < pairs; k++) {
+            // 1 - [0, 1) is in (0, 1], keeping log away from 0
+            radius[k] = 1 - rng_double(rng);
+            angle[k] = rng_double(rng);
+        }
+        for (int k = 0; k < pairs; k++) {
+            radius[k] = sqrt(-2 * log(radius[k])) * std_dev;
+            angle[k] *= 2 * M_PI;
+        }
+
+        double *block = values + start;
+        const int remaining = count - start;
+        for (int k = 0; k < pairs; k++) {
+            block[2 * k] = radius[k] * cos(angle[k]) + mean;
+            if (2 * k + 1 < remaining) {
+                block[2 * k + 1] = radius[k] * sin(angle[k]) + mean;
+            }
+        }
+    }
+}
@@ -0,0 +1,34 @@
+#ifndef RNG_H
+#define RNG_H
+
+#include <stdint.h>
+
+/*
+ * typedef struct: rng
+ * -------------------
+ * A xoshiro256** pseudo random number generator. Unlike rand() each
+ * generator carries its own state, so every thread or every network can
+ * draw from a stream of its own, and the state can be saved and restored
+ * to carry on a sequence exactly.
+ * state - the 256 bits of state, never all 0
+ */
+typedef struct rng {
+    uint64_t state[4];
+} Rng;
+
+extern void rng_seed(Rng *rng, uint64_t seed);
+
+extern void rng_stream(Rng *rng, uint64_t seed, uint64_t stream);
+
+extern void rng_split(Rng *child, Rng *parent);
+
+extern uint64_t rng_next(Rng *rng);
+
+extern double rng_double(Rng *rng);
+
+extern int rng_int(Rng *rng, int min, int max);
+
+extern void rng_gaussian(Rng *rng, double *values, int count, double mean,
+                         double std_dev);
+
+#endif
@@ -0,0 +1,160 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <limits.h>
+#include <math.h>
+
+#include "rng.h"
+#include "testutils.h"
+
+#define DRAWS 100000
+#define MAX_COUNT 200
+
+/*
+ * Checks rng_next against the outputs of the reference implementation of
+ * xoshiro256** from the state {1, 2, 3, 4}, and rng_seed against those of
+ * splitmix64 from 0
+ */
+void test_reference(void) {
+    const uint64_t expected[] = {11520ULL,
+                                 0ULL,
+                                 1509978240ULL,
+                                 1215971899390074240ULL,
+                                 1216172134540287360ULL,
+                                 607988272756665600ULL};
+    Rng rng = {.state = {1, 2, 3, 4}};
+    bool same = true;
+    for (int i = 0; i < 6; i++) {
+        same = same && rng_next(&rng) == expected[i];
+    }
+    testbool(same, "rng_next gives the reference xoshiro256** outputs");
+
+    rng_seed(&rng, 0);
+    testbool(rng.state[0] == 0xe220a8397b1dcdafULL &&
+                 rng.state[1] == 0x6e789e6aa1b965f4ULL &&
+                 rng.state[2] == 0x06c45d188009454fULL &&
+                 rng.state[3] == 0xf88bb8a8724c81ecULL,
+             "rng_seed fills the state with the splitmix64 sequence");
+}
+
+/*
+ * Returns true iff every draw of rng_int(min, max) is in [min, max], and
+ * both bounds are drawn when the range is small enough to expect them
+ */
+static bool int_bounds(Rng *rng, int min, int max) {
+    bool low = false, high = false;
+    for (int i = 0; i < DRAWS; i++) {
+        const int value = rng_int(rng, min, max);
+        if (value < min || value > max) {
+            return false;
+        }
+        low = low || value == min;
+        high = high || value == max;
+    }
+    return ((int64_t)max - min > 1000) || (low && high);
+}
+
+void test_int(void) {
+    Rng rng;
+    rng_seed(&rng, 1);
+    testbool(int_bounds(&rng, 0, 0), "rng_int of a single value");
+    testbool(int_bounds(&rng, -3, 3), "rng_int of a small range");
+    testbool(int_bounds(&rng, INT_MIN, INT_MIN + 1) &&
+                 int_bounds(&rng, INT_MAX - 1, INT_MAX),
+             "rng_int at the ends of the int range");
+
+    // halves of the full range should both come up about as often
+    int negative = 0;
+    bool in_range = true;
+    for (int i = 0; i < DRAWS; i++) {
+        const int64_t value = rng_int(&rng, INT_MIN, INT_MAX);
+        in_range = in_range && value >= INT_MIN && value <= INT_MAX;
+        negative += value < 0;
+    }
+    testbool(in_range && abs(negative - DRAWS / 2) < DRAWS / 50,
+             "rng_int from INT_MIN to INT_MAX covers the whole range");
+}
+
+/*
+ * Draws count values after a sentinel-filled buffer and checks that they
+ * are all finite, that nothing past count was written, and that they are
+ * the first count values of a longer draw from the same seed
+ */
+static bool gaussian_count(int count) {
+    double values[MAX_COUNT + 1], longer[MAX_COUNT + 2];
+    for (int i = 0; i <= count; i++) {
+        values[i] = -1e300;
+    }
+    Rng rng;
+    rng_seed(&rng, 2);
+    rng_gaussian(&rng, values, count, 0, 1);
+    rng_seed(&rng, 2);
+    rng_gaussian(&rng, longer, count + 1, 0, 1);
+
+    for (int i = 0; i < count; i++) {
+        if (!isfinite(values[i]) || values[i] == -1e300 ||
+            values[i] != longer[i]) {
+            return false;
+        }
+    }
+    return values[count] == -1e300;
+}
+
+void test_gaussian(void) {
+    bool odd = true;
+    for (int count = 1; count < MAX_COUNT; count += 2) {
+        odd = odd && gaussian_count(count);
+    }
+    testbool(odd, "rng_gaussian fills exactly an odd number of values");
+
+    bool blocks = true;
+    for (int count = 62; count <= 130; count++) {
+        blocks = blocks && gaussian_count(count);
+    }
+    testbool(blocks, "rng_gaussian of counts around and over 64");
+
+    static double values[DRAWS + 1];
+    Rng rng;
+    rng_seed(&rng, 3);
+    rng_gaussian(&rng, values, DRAWS + 1, 5, 2);
+    double sum = 0, squares = 0;
+    for (int i = 0; i <= DRAWS; i++) {
+        sum += values[i];
+        squares += values[i] * values[i];
+    }
+    const double mean = sum / (DRAWS + 1);
+    const double std_dev = sqrt(squares / (DRAWS + 1) - mean * mean);
+    testbool(fabs(mean - 5) < 0.05 && fabs(std_dev - 2) < 0.05,
+             "rng_gaussian has the given mean and standard deviation");
+}
+
+void test_streams(void) {
+    Rng first, second, again;
+    rng_stream(&first, 42, 0);
+    rng_stream(&second, 42, 1);
+    rng_stream(&again, 42, 0);
+    bool distinct = true, same = true;
+    for (int i = 0; i < 1000; i++) {
+        const uint64_t value = rng_next(&first);
+        distinct = distinct && value != rng_next(&second);
+        same = same && value == rng_next(&again);
+    }
+    testbool(distinct, "Distinct streams of a seed give distinct numbers");
+    testbool(same, "The same stream of a seed gives the same numbers");
+
+    Rng parent, child1, child2;
+    rng_seed(&parent, 42);
+    rng_split(&child1, &parent);
+    rng_split(&child2, &parent);
+    testbool(rng_next(&child1) != rng_next(&child2),
+             "Children split off one after the other differ");
+}
+
+int main(void) {
+    test_reference();
+    test_int();
+    test_gaussian();
+    test_streams();
+    return EXIT_SUCCESS;
+}
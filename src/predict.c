@@ -6,13 +6,20 @@
 #include <string.h>
 #include <time.h>
 
-#include "files.h"
+#include "csv.h"
+#include "dataset.h"
 #include "structures.h"
 #include "createstructures.h"
 #include "geneticutils.h"
 #include "mlp.h"
 #include "dataops.h"
 #include "managenn.h"
+#include "model.h"
+#include "parallel.h"
+
+// a window starts every day, so every day after the first window gets a
+// prediction
+#define WINDOW_STEP 1
 
 /*
  * Function: save_prediction
@@ -25,9 +32,11 @@
  * predictions - the predictions created
  * file - the file to save the predictions to
  * rows - the number of predictions there are
+ * window - the window the predictions were made from, the prediction of
+ *          the ith window being for the day after it
  */
 void save_predictions(bool actual, double **predictions, char file[],
-                      int rows) {
+                      int rows, const Window *window) {
     assert(file != NULL);
     FILE *f = fopen(file, "w+");
 
@@ -38,15 +47,15 @@ void save_predictions(bool actual, double **predictions, char file[],
         }
     } else {
         fprintf(f, "Date,Close,Predictions\n");
-        const char *cols[] = {"Close"};
-        int rows_data;
-        double **og_data = load_csv("misc_csv/data.csv", cols, 1, &rows_data);
+        const char *cols[] = {window->columns[window->target]};
+        CsvTable *og_data = load_dataset("misc_csv/data.csv", cols, 1, 1);
         for (int i = 0; i < rows; i++) {
-            fprintf(f, "%i,%lf,%lf\n", i, og_data[5 + 6 * i][0],
+            const int row = window->days + i * WINDOW_STEP;
+            fprintf(f, "%i,%lf,%lf\n", i, og_data->columns[0][row],
                     predictions[i][0]);
         }
 
-        free_pointer_matrix((void **)og_data, rows_data);
+        free_csv(og_data);
     }
 
     fclose(f);
@@ -56,10 +65,14 @@ void save_predictions(bool actual, double **predictions, char file[],
  * Function: main
  * --------------
  * Loads a nn and data to be used to create predictions and then 
- * saves those predictions in a file labelled "predictions.csv".
+ * saves those predictions in a file labelled "predictions.csv". The
+ * columns and days of the windows predicted from are those the model was
+ * trained with.
  *
- * file_name - path to data to be predicted, defaults to data.csv
- * load_name - path to the neural network to be loaded
+ * file_name - path to data to be predicted, defaults to data.csv, either a
+ *             CSV or a dataset
+ * load_name - path to the neural network to be loaded, either a binary
+ *             model or a CSV
  */
 int main(int argc, char **argv) {
     assert(argc == 2 || argc == 3);
@@ -78,45 +91,54 @@ int main(int argc, char **argv) {
         actual = false;
     }
 
-    const char *columns[] = {"Open", "High", "Low", "Close"};
-    int no_rows = 0;
-    double **data = load_csv(file_name, columns, 4, &no_rows);
-    double **data_formatted = format_nn_features(data, no_rows, 4);
-    free_pointer_matrix((void **)data, no_rows);
+    double min;
+    double max;
+    Window window;
+    MLP *mlp = load_model(load_name, &min, &max, &window);
 
-    printf("Data loaded...\n");
+    printf("MLP Loaded, taking %d days of %d columns...\n", window.days,
+           window.num_columns);
 
-    int rows = no_rows / NO_OF_DAYS;
-    double **normalised = normalise(data_formatted, rows, NO_FEATURES);
+    const char *columns[WINDOW_MAX_COLUMNS];
+    window_column_names(&window, columns);
+    const int no_cols = window.num_columns;
+    CsvTable *data = load_dataset(file_name, columns, no_cols,
+                                  parallel_default_workers());
+    const int no_rows = data->num_rows;
 
-    printf("Data normalised...\n");
+    printf("Data loaded...\n");
 
-    double min;
-    double max;
-    MLP *mlp = load_net(load_name, &min, &max);
+    double *normalised = interleave_columns(data->columns, no_rows, no_cols);
+    normalise_interleaved(normalised, no_rows, no_cols, NULL, NULL);
+    free_csv(data);
+    const SampleView windows = window_view(normalised, no_rows, no_cols,
+                                           window.days, WINDOW_STEP);
+    const int rows = windows.num_samples;
 
-    printf("MLP Loaded...\n");
+    printf("Data normalised...\n");
 
     printf("Predicting...\n");
-    double **predictions = (double **)calloc(rows, sizeof(double *));
-    for (int i = 0; i < rows; i++) {
-        predictions[i] = (double *)calloc(rows, sizeof(double));
-    }
+    // the whole dataset is predicted in one go, straight from the windows
+    const int num_outputs = mlp->output_layer->num_outputs;
+    double *outputs = malloc((size_t)rows * num_outputs * sizeof(double));
+    double **predictions = malloc(rows * sizeof(double *));
+    assert(outputs && predictions);
+    predict_strided(mlp, windows.base, windows.stride, rows, outputs,
+                    parallel_default_workers());
     for (int i = 0; i < rows; i++) {
-        forward_prop(mlp, normalised[i]);
-        predictions[i][0] = mlp->output_layer->outputs[0];
+        predictions[i] = outputs + (size_t)i * num_outputs;
     }
 
     rescale(predictions, min, max, rows, 0);
 
-    save_predictions(actual, predictions, "predictions.csv", rows);
+    save_predictions(actual, predictions, "predictions.csv", rows, &window);
 
     printf("Please look at \"predictions.csv\" for the predictions.\n");
 
     // Free everything
-    free_pointer_matrix((void **)data_formatted, rows);
-    free_pointer_matrix((void **)predictions, rows);
-    free_pointer_matrix((void **)normalised, rows);
+    free(predictions);
+    free(outputs);
+    free(normalised);
     mlp_free(mlp);
 
     return EXIT_SUCCESS;
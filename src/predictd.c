@@ -0,0 +1,544 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <assert.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include "structures.h"
+#include "geneticutils.h"
+#include "mlp.h"
+#include "dataops.h"
+#include "model.h"
+#include "parallel.h"
+
+#define MAX_CLIENTS 64
+#define MAX_LINE (1 << 20)
+#define READ_CHUNK 65536
+
+/*
+ * typedef struct: served_model
+ * ----------------------------
+ * A model loaded once for the whole life of the daemon
+ * name - the name requests refer to it by
+ * mlp - the network
+ * min, max - the minimum and maximum of its training targets, used to scale
+ *            the predictions back
+ * window - the window it takes its inputs from
+ */
+typedef struct served_model {
+    const char *name;
+    MLP *mlp;
+    double min;
+    double max;
+    Window window;
+} ServedModel;
+
+/*
+ * typedef struct: client
+ * ----------------------
+ * A connected client, what it sent that does not form a full line yet and
+ * the replies its socket has not taken yet
+ * fd - its nonblocking socket, -1 once it is gone
+ * buffer, used, capacity - what it sent
+ * output, pending, output_capacity - the replies still to be sent
+ */
+typedef struct client {
+    int fd;
+    char *buffer;
+    size_t used;
+    size_t capacity;
+    char *output;
+    size_t pending;
+    size_t output_capacity;
+} Client;
+
+/*
+ * typedef struct: request
+ * -----------------------
+ * One request line, parsed
+ * client - the client that sent it
+ * model - the index of the model asked for
+ * inputs - the normalised feature windows, one after the other
+ * windows - the number of windows
+ * offset - the position of its first window in the batch of its model
+ * error - why the request can not be answered, NULL if it can
+ */
+typedef struct request {
+    Client *client;
+    int model;
+    double *inputs;
+    int windows;
+    int offset;
+    const char *error;
+} Request;
+
+static volatile sig_atomic_t stopping = 0;
+
+static void stop(int signal) {
+    (void)signal;
+    stopping = 1;
+}
+
+/*
+ * Function: load_served_model
+ * ---------------------------
+ * Loads the model given on the command line as name=path, or just path in
+ * which case the path is also its name.
+ */
+static void load_served_model(ServedModel *model, char *spec) {
+    char *path = strchr(spec, '=');
+    if (path) {
+        *path++ = '\0';
+    } else {
+        path = spec;
+    }
+    model->name = spec;
+    model->mlp = load_model(path, &model->min, &model->max, &model->window);
+    printf("Serving %s as %s, taking %d days of %d columns\n", path,
+           model->name, model->window.days, model->window.num_columns);
+}
+
+/*
+ * Function: open_socket
+ * ---------------------
+ * Returns a UNIX stream socket listening at path, replacing any socket
+ * left there by an earlier daemon.
+ */
+static int open_socket(const char *path) {
+    struct sockaddr_un address = {.sun_family = AF_UNIX};
+    if (strlen(path) >= sizeof(address.sun_path)) {
+        fprintf(stderr, "The socket path %s is too long\n", path);
+        exit(EXIT_FAILURE);
+    }
+    strcpy(address.sun_path, path);
+
+    const int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) {
+        perror("Could not create the socket");
+        exit(EXIT_FAILURE);
+    }
+    unlink(path);
+    if (bind(fd, (struct sockaddr *)&address, sizeof(address)) ||
+        listen(fd, MAX_CLIENTS)) {
+        perror("Could not listen on the socket");
+        exit(EXIT_FAILURE);
+    }
+    return fd;
+}
+
+/*
+ * Function: queue_reply
+ * ---------------------
+ * Appends the message to the replies waiting to be sent to the client
+ */
+static void queue_reply(Client *client, const char *message, size_t len) {
+    if (client->output_capacity - client->pending < len) {
+        client->output_capacity = 2 * (client->pending + len);
+        client->output = realloc(client->output, client->output_capacity);
+        assert(client->output);
+    }
+    memcpy(client->output + client->pending, message, len);
+    client->pending += len;
+}
+
+/*
+ * Function: flush_client
+ * ----------------------
+ * Sends as much of the waiting replies as the socket takes without
+ * blocking, so that a client that does not read cannot hold up the others.
+ * The rest is sent once poll reports the socket writable. Returns false if
+ * the client is gone.
+ */
+static bool flush_client(Client *client) {
+    size_t sent = 0;
+    while (sent < client->pending) {
+        const ssize_t written = send(client->fd, client->output + sent,
+                                     client->pending - sent, MSG_NOSIGNAL);
+        if (written < 0 && errno == EINTR) {
+            continue;
+        }
+        if (written < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            break;
+        }
+        if (written <= 0) {
+            return false;
+        }
+        sent += written;
+    }
+    client->pending -= sent;
+    memmove(client->output, client->output + sent, client->pending);
+    return true;
+}
+
+/*
+ * Function: read_client
+ * ---------------------
+ * Appends what the client sent to its buffer, returns false once the
+ * client has disconnected or sent a line longer than MAX_LINE.
+ */
+static bool read_client(Client *client) {
+    if (client->capacity - client->used < READ_CHUNK) {
+        client->capacity = client->used + 2 * READ_CHUNK;
+        client->buffer = realloc(client->buffer, client->capacity);
+        assert(client->buffer);
+    }
+    const ssize_t received =
+        recv(client->fd, client->buffer + client->used, READ_CHUNK, 0);
+    if (received < 0 &&
+        (errno == EINTR || errno == EAGAIN || errno == EWOULDBLOCK)) {
+        return true;
+    }
+    if (received <= 0) {
+        return false;
+    }
+    client->used += received;
+    if (client->used > MAX_LINE &&
+        !memchr(client->buffer, '\n', client->used)) {
+        const char *error = "ERR line too long\n";
+        queue_reply(client, error, strlen(error));
+        flush_client(client);
+        return false;
+    }
+    return true;
+}
+
+/*
+ * Function: parse_request
+ * -----------------------
+ * Parses one request line, which is one of
+ *   PREDICT <model> <values>
+ *   OHLC <model> <values>
+ * where values holds one or more feature windows of the model, days *
+ * columns numbers each, separated by spaces or commas. PREDICT windows are
+ * already normalised, OHLC windows are the raw values of the columns of
+ * the model (the open, high, low and close prices by default) day by day,
+ * normalised column by column over all the days of the request as predict
+ * normalises a CSV.
+ */
+static void parse_request(Request *request, char *line,
+                          const ServedModel *models, int num_models) {
+    char *save;
+    const char *command = strtok_r(line, " ,\t\r", &save);
+    const char *name = strtok_r(NULL, " ,\t\r", &save);
+    if (!command || !name) {
+        request->error = "expected PREDICT or OHLC, a model and values";
+        return;
+    }
+    const bool raw = strcmp(command, "OHLC") == 0;
+    if (!raw && strcmp(command, "PREDICT") != 0) {
+        request->error = "unknown command";
+        return;
+    }
+    request->model = -1;
+    for (int m = 0; m < num_models; m++) {
+        if (strcmp(models[m].name, name) == 0) {
+            request->model = m;
+        }
+    }
+    if (request->model < 0) {
+        request->error = "unknown model";
+        return;
+    }
+
+    const Window *window = &models[request->model].window;
+    const int features = window_features(window);
+    int count = 0;
+    int capacity = features;
+    double *values = malloc(capacity * sizeof(double));
+    assert(values);
+    for (char *token = strtok_r(NULL, " ,\t\r", &save); token;
+         token = strtok_r(NULL, " ,\t\r", &save)) {
+        char *end;
+        const double value = strtod(token, &end);
+        if (*end != '\0') {
+            free(values);
+            request->error = "invalid number";
+            return;
+        }
+        if (count == capacity) {
+            capacity *= 2;
+            values = realloc(values, capacity * sizeof(double));
+            assert(values);
+        }
+        values[count++] = value;
+    }
+    if (count == 0 || count % features != 0) {
+        free(values);
+        request->error = "the values are not whole feature windows";
+        return;
+    }
+    request->windows = count / features;
+    request->inputs = values;
+
+    if (raw) {
+        const int days = request->windows * window->days;
+        const int columns = window->num_columns;
+        double min[columns], max[columns];
+        normalise_interleaved(values, days, columns, min, max);
+        for (int j = 0; j < columns; j++) {
+            if (min[j] == max[j]) {
+                request->error = "OHLC windows must differ in every column";
+                return;
+            }
+        }
+    }
+}
+
+/*
+ * Function: answer_requests
+ * -------------------------
+ * Answers every request received in this round. The windows of all the
+ * requests for a model, whichever client they came from, are predicted
+ * together with one call to predict_batch, then each client gets one line
+ * per request in the order it sent them: "OK" followed by the scaled
+ * prediction of every window, or "ERR" and the reason. The replies are
+ * queued, see flush_client.
+ */
+static void answer_requests(Request *requests, int num_requests,
+                            const ServedModel *models, int num_models,
+                            int workers) {
+    double *outputs[num_models];
+    for (int m = 0; m < num_models; m++) {
+        int total = 0;
+        for (int r = 0; r < num_requests; r++) {
+            if (!requests[r].error && requests[r].model == m) {
+                requests[r].offset = total;
+                total += requests[r].windows;
+            }
+        }
+        outputs[m] = NULL;
+        if (total == 0) {
+            continue;
+        }
+
+        const int features = window_features(&models[m].window);
+        double *inputs = malloc((size_t)total * features * sizeof(double));
+        outputs[m] = malloc((size_t)total * NO_OUTPUTS * sizeof(double));
+        assert(inputs && outputs[m]);
+        for (int r = 0; r < num_requests; r++) {
+            if (!requests[r].error && requests[r].model == m) {
+                memcpy(inputs + (size_t)requests[r].offset * features,
+                       requests[r].inputs,
+                       (size_t)requests[r].windows * features *
+                           sizeof(double));
+            }
+        }
+        predict_batch(models[m].mlp, inputs, total, outputs[m], workers);
+        free(inputs);
+    }
+
+    for (int r = 0; r < num_requests; r++) {
+        Request *request = &requests[r];
+        char *reply = NULL;
+        size_t len;
+        FILE *stream = open_memstream(&reply, &len);
+        if (!stream) {
+            perror("Could not write the reply");
+            exit(EXIT_FAILURE);
+        }
+        if (request->error) {
+            fprintf(stream, "ERR %s\n", request->error);
+        } else {
+            const ServedModel *model = &models[request->model];
+            const double *predictions =
+                outputs[request->model] + (size_t)request->offset * NO_OUTPUTS;
+            fprintf(stream, "OK");
+            for (int i = 0; i < request->windows * NO_OUTPUTS; i++) {
+                fprintf(stream, " %.17g",
+                        predictions[i] * (model->max - model->min) +
+                            model->min);
+            }
+            fprintf(stream, "\n");
+        }
+        fclose(stream);
+        if (request->client->fd >= 0) {
+            queue_reply(request->client, reply, len);
+        }
+        free(reply);
+        free(request->inputs);
+    }
+
+    for (int m = 0; m < num_models; m++) {
+        free(outputs[m]);
+    }
+}
+
+/*
+ * Function: main
+ * --------------
+ * A daemon serving predictions over a UNIX domain socket, so that the
+ * models are only loaded once instead of once per prediction as with
+ * predict. Every model given on the command line (binary or CSV, as
+ * name=path or path) is loaded at start up, then each line a client sends
+ * is answered with one line, see parse_request and answer_requests. All
+ * the requests that arrive together, from any number of clients, are
+ * predicted in one batch per model. SIGINT or SIGTERM stops the daemon.
+ *
+ * -j workers   - the number of threads predicting each batch, defaults to
+ *                the number of online processors
+ * socket_path  - where the socket is created
+ * models       - the models to serve
+ */
+int main(int argc, char **argv) {
+    int workers = parallel_default_workers();
+    int option;
+    while ((option = getopt(argc, argv, "j:")) != -1) {
+        switch (option) {
+            case 'j':
+                workers = atoi(optarg);
+                break;
+            default:
+                exit(EXIT_FAILURE);
+        }
+    }
+    assert(workers > 0);
+    if (argc - optind < 2) {
+        fprintf(stderr, "Usage: %s [-j workers] <socket_path> <model>...\n",
+                argv[0]);
+        exit(EXIT_FAILURE);
+    }
+
+    const char *socket_path = argv[optind];
+    const int num_models = argc - optind - 1;
+    ServedModel models[num_models];
+    for (int m = 0; m < num_models; m++) {
+        load_served_model(&models[m], argv[optind + 1 + m]);
+    }
+
+    struct sigaction action = {.sa_handler = stop};
+    sigemptyset(&action.sa_mask);
+    sigaction(SIGINT, &action, NULL);
+    sigaction(SIGTERM, &action, NULL);
+
+    const int listener = open_socket(socket_path);
+    printf("Listening on %s\n", socket_path);
+    fflush(stdout);
+
+    Client *clients[MAX_CLIENTS];
+    int num_clients = 0;
+    int request_capacity = MAX_CLIENTS;
+    Request *requests = malloc(request_capacity * sizeof(Request));
+    assert(requests);
+
+    while (!stopping) {
+        struct pollfd fds[MAX_CLIENTS + 1];
+        fds[0] = (struct pollfd){.fd = listener, .events = POLLIN};
+        // a client is not read from while a line worth of replies waits
+        // for it, so that one that only sends cannot fill the memory
+        for (int c = 0; c < num_clients; c++) {
+            const Client *client = clients[c];
+            fds[c + 1] = (struct pollfd){
+                .fd = client->fd,
+                .events = (client->pending > MAX_LINE ? 0 : POLLIN) |
+                          (client->pending > 0 ? POLLOUT : 0)};
+        }
+        if (poll(fds, num_clients + 1, -1) < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            perror("Could not wait for the clients");
+            exit(EXIT_FAILURE);
+        }
+
+        // read what every ready client sent, splitting it into requests
+        int num_requests = 0;
+        for (int c = 0; c < num_clients; c++) {
+            Client *client = clients[c];
+            if ((fds[c + 1].revents & POLLOUT) && !flush_client(client)) {
+                close(client->fd);
+                client->fd = -1;
+                continue;
+            }
+            if (!(fds[c + 1].revents & (POLLIN | POLLHUP | POLLERR))) {
+                continue;
+            }
+            if (!read_client(client)) {
+                close(client->fd);
+                client->fd = -1;
+                continue;
+            }
+
+            char *line = client->buffer;
+            char *end;
+            while ((end = memchr(line, '\n',
+                                 client->buffer + client->used - line))) {
+                *end = '\0';
+                if (num_requests == request_capacity) {
+                    request_capacity *= 2;
+                    requests =
+                        realloc(requests, request_capacity * sizeof(Request));
+                    assert(requests);
+                }
+                Request *request = &requests[num_requests++];
+                *request = (Request){.client = client};
+                parse_request(request, line, models, num_models);
+                line = end + 1;
+            }
+            client->used -= line - client->buffer;
+            memmove(client->buffer, line, client->used);
+        }
+        answer_requests(requests, num_requests, models, num_models, workers);
+        for (int c = 0; c < num_clients; c++) {
+            Client *client = clients[c];
+            if (client->fd >= 0 && client->pending > 0 &&
+                !flush_client(client)) {
+                close(client->fd);
+                client->fd = -1;
+            }
+        }
+
+        // drop the clients that are gone, then take the new ones
+        int kept = 0;
+        for (int c = 0; c < num_clients; c++) {
+            if (clients[c]->fd >= 0) {
+                clients[kept++] = clients[c];
+            } else {
+                free(clients[c]->buffer);
+                free(clients[c]->output);
+                free(clients[c]);
+            }
+        }
+        num_clients = kept;
+
+        if (fds[0].revents & POLLIN) {
+            const int fd = accept(listener, NULL, NULL);
+            if (fd >= 0 && num_clients == MAX_CLIENTS) {
+                const char *error = "ERR too many clients\n";
+                send(fd, error, strlen(error), MSG_NOSIGNAL | MSG_DONTWAIT);
+                close(fd);
+            } else if (fd >= 0) {
+                if (fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK) < 0) {
+                    perror("Could not make the client socket nonblocking");
+                    exit(EXIT_FAILURE);
+                }
+                Client *client = calloc(1, sizeof(Client));
+                assert(client);
+                client->fd = fd;
+                clients[num_clients++] = client;
+            }
+        }
+    }
+
+    printf("Stopping\n");
+    close(listener);
+    unlink(socket_path);
+    for (int c = 0; c < num_clients; c++) {
+        close(clients[c]->fd);
+        free(clients[c]->buffer);
+        free(clients[c]->output);
+        free(clients[c]);
+    }
+    free(requests);
+    for (int m = 0; m < num_models; m++) {
+        mlp_free(models[m].mlp);
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -2,11 +2,15 @@
 #include <stdlib.h>
 #include <stdbool.h>
 #include <assert.h>
+#include <getopt.h>
+#include <inttypes.h>
 #include <limits.h>
 #include <string.h>
 #include <time.h>
+#include <unistd.h>
 
-#include "files.h"
+#include "csv.h"
+#include "dataset.h"
 #include "structures.h"
 #include "createstructures.h"
 #include "crossover.h"
@@ -15,9 +19,23 @@
 #include "mlp.h"
 #include "dataops.h"
 #include "managenn.h"
+#include "training.h"
+#include "fitnesscache.h"
+#include "parallel.h"
+#include "migration.h"
+#include "checkpoint.h"
+#include "model.h"
 
 #define MLP_TRAINING_EPOCHS 500
 #define VALIDATION_RATIO 0.2
+#define FITNESS_CACHE_CAPACITY 1024
+#define EARLY_STOPPING_INTERVAL 10
+#define HELD_OUT_RATIO 0.1
+#define HALVING_KEEP_FRACTION 0.5
+#define ISLAND_MIGRANTS 2
+#define CHECKPOINT_FILE "checkpoint.bin"
+#define ISLAND_CHECKPOINT_FILE "checkpoint_%d.bin"
+#define WINDOW_STEP 1
 
 /*
  * Function: iteration_printing
@@ -52,6 +70,33 @@ void iteration_printing(GeneticState *state) {
     printf("Nodes per layer: %d\n",
            state->fittest_individual_currently->nodes_per_layer);
     printf("-----------------\n");
+
+    const Generation *generation = state->current_generation;
+    long epochs = 0;
+    int trained = 0;
+    for (int i = 0; i < generation->population_size; ++i) {
+        if (!generation->population[i]->cached) {
+            epochs += generation->population[i]->epochs_trained;
+            ++trained;
+        }
+    }
+    if (trained > 0) {
+        printf("Average epochs trained this generation: %.1lf\n",
+               (double)epochs / trained);
+        printf("-----------------\n");
+    }
+
+    if (state->cache) {
+        const FitnessCache *cache = state->cache;
+        printf("Fitness cache hits this generation: %d/%d (%.1lf%%)\n",
+               cache->generation_hits, cache->generation_lookups,
+               100.0 * cache->generation_hits / cache->generation_lookups);
+        printf("Fitness cache hits so far: %ld/%ld (%.1lf%%), %d networks "
+               "cached\n",
+               cache->hits, cache->lookups, 100.0 * cache->hits / cache->lookups,
+               cache->size);
+        printf("-----------------\n");
+    }
 }
 
 /*
@@ -63,8 +108,11 @@ void iteration_printing(GeneticState *state) {
  *  state: current genetic state
  *  targets: *DESCALED* target values
  *  num_targets: number of targets
+ *  window: the window the networks take their inputs from, saved with the
+ *          binary model
  */
-void terminate_genetic(GeneticState *state, double **targets, int num_targets) {
+void terminate_genetic(GeneticState *state, double **targets, int num_targets,
+                       const Window *window) {
     // output NN here
     printf(
         "After %d generations, with mutation probability set to %lf, the "
@@ -74,8 +122,10 @@ void terminate_genetic(GeneticState *state, double **targets, int num_targets) {
         state->fittest_individual->fitness,
         1 / state->fittest_individual->fitness);
 
-    // Save NN
+    // Save NN, as CSV and as a binary model
     save_nn(state->fittest_individual, "nn.csv", targets, num_targets);
+    save_model(state->fittest_individual, "nn.bin", targets, num_targets,
+               window);
     // free everything
     free_genetic_state(state);
 }
@@ -89,14 +139,15 @@ void terminate_genetic(GeneticState *state, double **targets, int num_targets) {
  * the networks train for and the pecentage of the dataset used for evaluation
  * (that is calculating the fitness for the selection) are both controlled
  * by macros defined at the top of this file. At the end the best neural
- * network is saved to a local file "nn.csv". The following command line
+ * network is saved to a local file "nn.csv", and in the binary model format
+ * to "nn.bin". The following command line
  * arguments are required:
  *
  * dataset_csv          - path to the location of the Yahoo Finance dataset,
- * 						  must have the number of rows >= number of days
- * 						  in a batch (currently set to 6 in dataops.h)
- * 						  * 2, the rows which can't fit in a batch
- * 						  are discarded.
+ * 						  which must have more rows than days in a
+ * 						  window. It is cached as a dataset next to
+ * 						  it (see load_dataset), which can also be given
+ * 						  instead.
  * number_generations   - the number of generations the genetic algorithm
  * 						  should run for
  * population_size      - the size of the population, how many networks are
@@ -104,57 +155,218 @@ void terminate_genetic(GeneticState *state, double **targets, int num_targets) {
  * mutation_probability - a float between 0 and 1 that is the chance of 
  * 						  something random happening at crossover, 
  * 						  improves diversity
+ *
+ * They can be preceded by the following options:
+ *
+ * -j workers           - the number of threads used to train and evaluate
+ * 						  each generation, defaults to the number of
+ * 						  online processors (divided between the islands
+ * 						  with -i, -j being the threads of each island)
+ * -b batch_size        - the number of samples per weight update when
+ * 						  training the networks, defaults to 1
+ * -c quantum           - reuse the trained network and fitness of an
+ * 						  earlier individual with the same genome instead
+ * 						  of training again, learning rates rounding to
+ * 						  the same multiple of quantum count as the same
+ * 						  (0 for exact matches only). Off by default
+ * -w warm_epochs       - children whose hidden layers are as wide as a
+ * 						  parent's start from that parent's trained
+ * 						  weights and are only trained for warm_epochs
+ * 						  epochs. Off by default
+ * -e patience          - stop training a network once its cost on rows
+ * 						  held out of the training set has not improved
+ * 						  for patience checks, made every 10 epochs, or
+ * 						  has diverged. The number of epochs then becomes
+ * 						  an upper bound. Off by default
+ * -s rungs             - successive halving: train every network for a
+ * 						  fraction of its epochs, rank them on the
+ * 						  validation rows and only train the better half
+ * 						  further, over the given number of rungs. Off by
+ * 						  default
+ * -i islands           - island model: run that many populations in
+ * 						  separate processes, the fittest individuals of
+ * 						  each migrating to the others. Defaults to 1
+ * -m interval          - the number of generations between migrations,
+ * 						  defaults to 5
+ * -t topology          - where migrants go, "ring" (the next island,
+ * 						  the default) or "full" (every other island)
+ * -k interval          - save a checkpoint of the whole state every
+ * 						  interval generations to checkpoint.bin
+ * 						  (checkpoint_<island>.bin with islands)
+ * -r                   - resume from the checkpoint instead of starting
+ * 						  with a new population
+ * --seed seed, -S seed - the master seed every random number of the run
+ * 						  is derived from, so that running again with the
+ * 						  same seed and options gives the same networks.
+ * 						  Defaults to the current time, and is printed
+ * 						  at the start of the run
+ * --step step, -W step - the number of days between the starts of
+ * 						  consecutive windows of the dataset, from 1 (every
+ * 						  day is the target of a window, the default) to
+ * 						  days + 1 (disjoint windows, as in the first
+ * 						  versions)
+ * --days days, -d days - the number of consecutive days in the window the
+ * 						  networks take as inputs, defaults to 5
+ * --features columns,  - the comma separated columns of the dataset taken
+ *   -f columns			  for each day of the window, which must include
+ * 						  Close, the column predicted. Defaults to
+ * 						  Open,High,Low,Close
+ *
+ * The window is saved in the header of nn.bin, so predict takes the same
+ * inputs without being told.
  */
 int main(int argc, char **argv) {
-    assert(argc == 5);
+    int workers = parallel_default_workers();
+    bool workers_given = false;
+    TrainingOptions training_options = {.epochs = MLP_TRAINING_EPOCHS,
+                                        .batch_size = 1,
+                                        .warm_start_epochs = 0};
+    bool inherit_weights = false;
+    int patience = 0;
+    int rungs = 0;
+    int num_islands = 1;
+    int migration_interval = 5;
+    MigrationTopology topology = TOPOLOGY_RING;
+    int checkpoint_interval = 0;
+    bool resume = false;
+    uint64_t seed = time(NULL);
+    int window_step = WINDOW_STEP;
+    int window_days = DEFAULT_WINDOW_DAYS;
+    const char *window_columns = DEFAULT_WINDOW_COLUMNS;
+
+    double cache_quantum = -1;
+
+    const struct option long_options[] = {{"seed", required_argument, NULL, 'S'},
+                                          {"step", required_argument, NULL, 'W'},
+                                          {"days", required_argument, NULL, 'd'},
+                                          {"features", required_argument, NULL, 'f'},
+                                          {NULL, 0, NULL, 0}};
+    int option;
+    while ((option = getopt_long(argc, argv, "j:b:c:w:e:s:i:m:t:k:rS:W:d:f:",
+                                 long_options, NULL)) != -1) {
+        switch (option) {
+            case 'j':
+                workers = atoi(optarg);
+                workers_given = true;
+                break;
+            case 'b':
+                training_options.batch_size = atoi(optarg);
+                break;
+            case 'c':
+                cache_quantum = strtod(optarg, NULL);
+                assert(cache_quantum >= 0);
+                break;
+            case 'w':
+                training_options.warm_start_epochs = atoi(optarg);
+                inherit_weights = true;
+                break;
+            case 'e':
+                patience = atoi(optarg);
+                assert(patience > 0);
+                break;
+            case 's':
+                rungs = atoi(optarg);
+                assert(rungs > 0);
+                break;
+            case 'i':
+                num_islands = atoi(optarg);
+                assert(num_islands > 0);
+                break;
+            case 'm':
+                migration_interval = atoi(optarg);
+                assert(migration_interval > 0);
+                break;
+            case 't':
+                if (!parse_topology(optarg, &topology)) {
+                    fprintf(stderr, "Unknown topology: %s\n", optarg);
+                    exit(EXIT_FAILURE);
+                }
+                break;
+            case 'k':
+                checkpoint_interval = atoi(optarg);
+                assert(checkpoint_interval > 0);
+                break;
+            case 'r':
+                resume = true;
+                break;
+            case 'S':
+                seed = strtoull(optarg, NULL, 10);
+                break;
+            case 'W':
+                window_step = atoi(optarg);
+                assert(window_step > 0);
+                break;
+            case 'd':
+                window_days = atoi(optarg);
+                break;
+            case 'f':
+                window_columns = optarg;
+                break;
+            default:
+                exit(EXIT_FAILURE);
+        }
+    }
+    assert(argc - optind == 4);
+    argv += optind;
 
-    char *filename = argv[1];
-    int number_generations = atoi(argv[2]);
-    int population_size = atoi(argv[3]);
-    double mutation_probability = strtod(argv[4], NULL);
+    char *filename = argv[0];
+    int number_generations = atoi(argv[1]);
+    int population_size = atoi(argv[2]);
+    double mutation_probability = strtod(argv[3], NULL);
     double (*fitness_function)(MLP *, double **, double **, int) =
         calculate_fitness;
 
     assert(fitness_function);
     assert(number_generations > 0);
     assert(population_size > 1);
+    assert(workers > 0);
+    assert(training_options.batch_size > 0);
+    assert(training_options.warm_start_epochs >= 0);
     assert(mutation_probability >= MUTATION_LOWER &&
            mutation_probability <= MUTATION_UPPER);
 
-    srand(time(NULL));
-
-    // load data from CSV
-    int no_of_rows = 0;
-    const char *columns[] = {"Open", "High", "Low", "Close"};
-    int no_of_cols = 4;
-    double **data = load_csv(filename, columns, no_of_cols, &no_of_rows);
-    double **data_formatted = format_nn_features(data, no_of_rows, no_of_cols);
-    free_pointer_matrix((void **)data, no_of_rows);
-
-    // load targets from CSV
-    int no_targets = 0;
-    const char *targetcols[] = {"Close"};
-    int no_target_cols = 1;
-    double **targets_aux =
-        load_csv(filename, targetcols, no_target_cols, &no_targets);
-    double **targets_formatted = format_targets(targets_aux, no_targets);
-    free_pointer_matrix((void **)targets_aux, no_targets);
-
-    const int formatted_rows = no_of_rows / NO_OF_DAYS;
-    assert(formatted_rows > 5);
-    assert(no_targets == no_of_rows);
+    Window window;
+    if (!parse_window(&window, window_days, window_columns)) {
+        fprintf(stderr,
+                "Invalid window of %d days of %s, the columns must include "
+                "%s\n",
+                window_days, window_columns, WINDOW_TARGET);
+        exit(EXIT_FAILURE);
+    }
 
-    // normalise data
-    double **denormalised_data = data_formatted;
-    data_formatted = normalise(data_formatted, formatted_rows, NO_FEATURES);
+    printf("Seed: %" PRIu64 "\n", seed);
+
+    // load the features and the targets from the CSV (or its cache) in one
+    // go, the targets being the Close column
+    const char *columns[WINDOW_MAX_COLUMNS];
+    window_column_names(&window, columns);
+    const int no_of_cols = window.num_columns;
+    CsvTable *table = load_dataset(filename, columns, no_of_cols, workers);
+    const int no_of_rows = table->num_rows;
+
+    // normalise the columns, then view them as overlapping windows of
+    // window.days days, each followed by the close it predicts, without
+    // copying them
+    double *normalised =
+        interleave_columns(table->columns, no_of_rows, no_of_cols);
+    normalise_interleaved(normalised, no_of_rows, no_of_cols, NULL, NULL);
+    const int days = window.days;
+    double **data_formatted = view_rows(
+        window_view(normalised, no_of_rows, no_of_cols, days, window_step));
+    double **targets_formatted = view_rows(target_view(
+        normalised, no_of_rows, no_of_cols, window.target, days, window_step));
+    const int formatted_rows = count_windows(no_of_rows, days, window_step);
+    assert(formatted_rows > 5);
 
-    // normalise features
-    double **denormalised_targets = targets_formatted;
-    targets_formatted = normalise(targets_formatted, formatted_rows, 1);
+    // the closes the targets were normalised over, for rescaling
+    SampleView closes = {.base = table->columns[window.target],
+                         .stride = 1,
+                         .num_samples = no_of_rows};
+    double **denormalised_targets = view_rows(closes);
 
     //split into training and validation
     const int validation_rows = VALIDATION_RATIO * (double)formatted_rows;
-    const int training_rows = formatted_rows - validation_rows;
+    int training_rows = formatted_rows - validation_rows;
 
     double **training_data = data_formatted + validation_rows;
     double **validation_data = data_formatted;
@@ -162,22 +374,100 @@ int main(int argc, char **argv) {
     double **training_targets = targets_formatted + validation_rows;
     double **validation_targets = targets_formatted;
 
+    // early stopping holds out the start of the training rows, so that the
+    // validation rows stay unseen until selection
+    EarlyStopping early_stopping = {.check_interval = EARLY_STOPPING_INTERVAL,
+                                    .patience = patience};
+    if (patience > 0) {
+        const int held_out_rows = HELD_OUT_RATIO * (double)training_rows;
+        assert(held_out_rows > 0 && held_out_rows < training_rows);
+        early_stopping.inputs = training_data;
+        early_stopping.targets = training_targets;
+        early_stopping.num_rows = held_out_rows;
+        training_data += held_out_rows;
+        training_targets += held_out_rows;
+        training_rows -= held_out_rows;
+        training_options.early_stopping = &early_stopping;
+    }
+
+    SuccessiveHalving halving = {.rungs = rungs,
+                                 .keep_fraction = HALVING_KEEP_FRACTION,
+                                 .inputs = validation_data,
+                                 .targets = validation_targets,
+                                 .num_rows = validation_rows};
+    if (rungs > 0) {
+        training_options.halving = &halving;
+    }
+
+    // every island evolves its own population from its own stream of the
+    // seed, sharing the data loaded so far
+    Island *island = NULL;
+    if (num_islands > 1) {
+        island = create_islands(num_islands, topology, migration_interval,
+                                ISLAND_MIGRANTS);
+        // the islands share the processors instead of each of them starting
+        // a thread per processor, the first ones taking any left over
+        if (!workers_given) {
+            workers = workers / num_islands +
+                      (island->id < workers % num_islands);
+            if (workers < 1) {
+                workers = 1;
+            }
+        }
+    }
+
+    char checkpoint_file[64];
+    if (island) {
+        sprintf(checkpoint_file, ISLAND_CHECKPOINT_FILE, island->id);
+    } else {
+        strcpy(checkpoint_file, CHECKPOINT_FILE);
+    }
+
     // assign parameter values to state
-    GeneticState *state = create_genetic_state();
-    state->mutation_probability = mutation_probability;
+    GeneticState *state;
+    if (resume) {
+        state = load_checkpoint(checkpoint_file);
+        if (state->current_generation->population_size != population_size) {
+            fprintf(stderr, "The checkpoint has a population of %d\n",
+                    state->current_generation->population_size);
+            exit(EXIT_FAILURE);
+        }
+        if (state->num_features != window_features(&window)) {
+            fprintf(stderr, "The checkpoint holds networks of %d inputs\n",
+                    state->num_features);
+            exit(EXIT_FAILURE);
+        }
+    } else {
+        state = create_genetic_state();
+        state->num_features = window_features(&window);
+        rng_stream(&state->rng, seed, island ? island->id : 0);
+        state->mutation_probability = mutation_probability;
+    }
     state->fitness_function = fitness_function;
+    state->workers = workers;
+    // a generation never takes more networks from the pool than its size
+    state->pool->capacity = population_size;
+    if (cache_quantum >= 0) {
+        state->cache =
+            create_fitness_cache(cache_quantum, FITNESS_CACHE_CAPACITY);
+    }
 
     // population initalisation
-    init_population(state, population_size);
+    if (!resume) {
+        init_population(state, population_size);
+    }
+    pid_t checkpoint_writer = 0;
 
     // evolution process
     while (state->generation_number < number_generations) {
         // train networks
-        for (int i = 0; i < state->current_generation->population_size; ++i) {
-            Chromosome *chr;
-            chr = state->current_generation->population[i];
-            train(chr->mlp, training_data, training_rows, training_targets,
-                  chr->learning_rate, MLP_TRAINING_EPOCHS);
+        train_generation(state, training_data, training_rows,
+                         training_targets, &training_options);
+
+        // swap the fittest individuals with the neighbouring islands
+        if (migration_due(island, state->generation_number)) {
+            migrate(island, state, validation_targets, validation_data,
+                    validation_rows);
         }
 
         // apply fitness function to generation
@@ -195,26 +485,52 @@ int main(int argc, char **argv) {
 
         for (int i = 0; i < population_size; ++i) {
             population[i] = crossover(parents[2 * i], parents[2 * i + 1],
-                                      mutation_probability);
+                                      mutation_probability, state->pool,
+                                      inherit_weights, &state->rng);
         }
 
+        if (island) {
+            printf("Island %d\n", island->id);
+        }
         iteration_printing(state);
+        fflush(stdout);
         generation->population = population;
         free(parents);
 
         // set new generation in state
-        free_generation(state->current_generation, state->fittest_individual);
+        free_generation(state->current_generation, state->fittest_individual,
+                        state->pool);
         state->current_generation = generation;
         state->generation_number += 1;
+
+        // the checkpoint is written in the background
+        if (checkpoint_interval > 0 &&
+            state->generation_number % checkpoint_interval == 0) {
+            wait_checkpoint(checkpoint_writer);
+            checkpoint_writer =
+                save_checkpoint_background(state, checkpoint_file);
+        }
     }
+    wait_checkpoint(checkpoint_writer);
 
-    // free the state and the csv file
-    terminate_genetic(state, denormalised_targets, formatted_rows);
-    free_pointer_matrix((void **)denormalised_data, formatted_rows);
-    free_pointer_matrix((void **)denormalised_targets, formatted_rows);
+    // only island 0 saves the fittest network of all the islands
+    if (island) {
+        gather_fittest(island, state, validation_targets, validation_data,
+                       validation_rows);
+    }
 
-    free_pointer_matrix((void **)data_formatted, formatted_rows);
-    free_pointer_matrix((void **)targets_formatted, formatted_rows);
+    // free the state and the csv file
+    if (!island || island->id == 0) {
+        terminate_genetic(state, denormalised_targets, no_of_rows, &window);
+    } else {
+        free_genetic_state(state);
+    }
+    free_island(island);
+    free(denormalised_targets);
+    free(data_formatted);
+    free(targets_formatted);
+    free(normalised);
+    free_csv(table);
 
     return EXIT_SUCCESS;
 }